@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "abelian_group.h"
+#include "matrix.h"
+#include "p_local.h"
+#include "sparse_matrix.h"
+
+// Seeded generators for benchmark inputs. The same arguments always give the
+// same inputs, so timings are comparable between builds. Values are drawn by
+// modular arithmetic on the output of the engine, which the standard fixes,
+// rather than by the distributions of the standard library, which it does not.
+
+inline std::mt19937_64 bench_rng(const std::uint64_t seed)
+{
+  return std::mt19937_64(0x9e3779b97f4a7c15ull ^ seed);
+}
+
+// Matrix with integer entries in [-bound, bound], each nonzero with
+// probability density_percent / 100.
+inline MatrixQ random_matrix(std::mt19937_64& rng, const std::size_t height,
+                             const std::size_t width,
+                             const long density_percent, const long bound = 9)
+{
+  MatrixQ f(height, width);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      if (long(rng() % 100) < density_percent)
+        f(i, j) = long(rng() % std::uint64_t(2 * bound + 1)) - bound;
+    }
+  }
+
+  return f;
+}
+
+// Sparse matrix with up to row_entries nonzero entries in [-bound, bound] in
+// every row, in random columns.
+inline SparseMatrixQ random_sparse_matrix(std::mt19937_64& rng,
+                                          const std::size_t height,
+                                          const std::size_t width,
+                                          const std::size_t row_entries,
+                                          const long bound = 9)
+{
+  std::vector<std::vector<SparseMatrixQ::Entry>> rows(height);
+  for (std::vector<SparseMatrixQ::Entry>& row : rows) {
+    std::vector<std::size_t> cols;
+    for (std::size_t k = 0; k < row_entries; ++k) cols.push_back(rng() % width);
+    std::sort(cols.begin(), cols.end());
+    cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+
+    for (const std::size_t j : cols) {
+      const long value = 1 + long(rng() % std::uint64_t(bound));
+      row.push_back({j, mpq_class(rng() % 2 ? value : -value)});
+    }
+  }
+
+  return SparseMatrixQ(width, std::move(rows));
+}
+
+// Finite group of the given rank with exponents in [1, max_order].
+inline AbelianGroup random_group(std::mt19937_64& rng, const std::size_t rank,
+                                 const std::size_t max_order)
+{
+  AbelianGroup group(0, rank);
+  for (std::size_t i = 0; i < rank; ++i)
+    group(i) = 1 + static_cast<std::size_t>(rng() % max_order);
+
+  return group;
+}
+
+// Random homomorphism X -> Y of finite groups: the entry mapping generator j
+// to generator i is divisible by p^(Y(i) - X(j)).
+inline MatrixQ random_morphism(std::mt19937_64& rng, const std::size_t p,
+                               const AbelianGroup& X, const AbelianGroup& Y,
+                               const long density_percent)
+{
+  MatrixQ f = random_matrix(rng, Y.rank(), X.rank(), density_percent);
+
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    for (std::size_t j = 0; j < X.tor_rank(); ++j) {
+      if (Y(i) > X(j)) f(i, j) *= p_pow_z(p, Y(i) - X(j));
+    }
+  }
+
+  return f;
+}
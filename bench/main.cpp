@@ -0,0 +1,26 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+// Like BENCHMARK_MAIN, but reports JSON unless another format is requested.
+int main(int argc, char** argv)
+{
+  std::vector<char*> args(argv, argv + argc);
+
+  bool has_format = false;
+  for (int k = 1; k < argc; ++k) {
+    if (std::strncmp(argv[k], "--benchmark_format", 18) == 0) has_format = true;
+  }
+
+  std::string json = "--benchmark_format=json";
+  if (!has_format) args.push_back(&json[0]);
+
+  int args_size = static_cast<int>(args.size());
+  benchmark::Initialize(&args_size, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_size, args.data())) return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+}
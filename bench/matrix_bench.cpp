@@ -0,0 +1,109 @@
+#include "benchmark/benchmark.h"
+
+#include "generators.h"
+#include "matrix.h"
+#include "mod_kernels.h"
+#include "zpn.h"
+
+// Arguments: size, density in percent.
+static void BM_MatrixProduct(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  const MatrixQ f = random_matrix(rng, n, n, state.range(1));
+  const MatrixQ g = random_matrix(rng, n, n, state.range(1));
+
+  for (auto _ : state) {
+    MatrixQ h = f * g;
+    benchmark::DoNotOptimize(&h);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_MatrixProduct)
+    ->ArgsProduct({{16, 64, 128}, {10, 100}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Arguments: size, Strassen threshold (0 for the classical product only).
+static void BM_MatrixProductStrassen(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  const MatrixQ f = random_matrix(rng, n, n, 100);
+  const MatrixQ g = random_matrix(rng, n, n, 100);
+
+  const std::size_t threshold = strassen_threshold();
+  set_strassen_threshold(static_cast<std::size_t>(state.range(1)));
+  for (auto _ : state) {
+    MatrixQ h = f * g;
+    benchmark::DoNotOptimize(&h);
+  }
+  set_strassen_threshold(threshold);
+}
+BENCHMARK(BM_MatrixProductStrassen)
+    ->ArgsProduct({{256, 512}, {0, 64, 128, 256}})
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: size. One iteration adds every row to the next one and undoes
+// this in reverse order, so that the entries do not grow.
+static void BM_RowAdd(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  MatrixQ f = random_matrix(rng, n, n, 100);
+  const mpq_class lambda(3, 2);
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i + 1 < n; ++i) f.row_add(i, i + 1, lambda);
+    for (std::size_t i = n - 1; i > 0; --i) f.row_add(i - 1, i, -lambda);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2 * (state.range(0) - 1));
+}
+BENCHMARK(BM_RowAdd)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_ColAdd(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  MatrixQ f = random_matrix(rng, n, n, 100);
+  const mpq_class lambda(3, 2);
+
+  for (auto _ : state) {
+    for (std::size_t j = 0; j + 1 < n; ++j) f.col_add(j, j + 1, lambda);
+    for (std::size_t j = n - 1; j > 0; --j) f.col_add(j - 1, j, -lambda);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2 * (state.range(0) - 1));
+}
+BENCHMARK(BM_ColAdd)->Arg(16)->Arg(64)->Arg(256);
+
+// Arguments: size, kernels (0 scalar, 1 AVX2, 2 AVX-512). Entries are in
+// Z/3^20, whose modulus fits into 32 bits.
+static void BM_RowAddZpn(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  const ModKernels best = mod_kernels();
+  if (!set_mod_kernels(static_cast<ModKernels>(state.range(1)))) {
+    state.SkipWithError("kernels not supported");
+    return;
+  }
+
+  Zpn::Precision precision(3, 20);
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  const MatrixQ f_q = random_matrix(rng, n, n, 100);
+  Matrix<Zpn> f(n, n);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = 0; j < n; ++j) f(i, j) = Zpn(f_q(i, j));
+  }
+  const Zpn lambda(5);
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i + 1 < n; ++i) f.row_add(i, i + 1, lambda);
+    for (std::size_t i = n - 1; i > 0; --i) f.row_add(i - 1, i, -lambda);
+  }
+
+  set_mod_kernels(best);
+  state.SetItemsProcessed(state.iterations() * 2 * (state.range(0) - 1));
+}
+BENCHMARK(BM_RowAddZpn)->ArgsProduct({{64, 256, 1024}, {0, 1, 2}});
@@ -0,0 +1,125 @@
+#include "benchmark/benchmark.h"
+
+#include "generators.h"
+#include "morphisms.h"
+
+namespace {
+
+struct MorphismInput {
+  explicit MorphismInput(const benchmark::State& state)
+      : p(static_cast<std::size_t>(state.range(1))),
+        rng(bench_rng(static_cast<std::uint64_t>(
+            state.range(0) * 1000003 + state.range(1) * 1009 +
+            state.range(2)))),
+        X(random_group(rng, static_cast<std::size_t>(state.range(0)),
+                       static_cast<std::size_t>(state.range(2)))),
+        Y(random_group(rng, static_cast<std::size_t>(state.range(0)),
+                       static_cast<std::size_t>(state.range(2)))),
+        f(random_morphism(rng, p, X, Y, 50))
+  {
+  }
+
+  const std::size_t p;
+  std::mt19937_64 rng;
+  const AbelianGroup X;
+  const AbelianGroup Y;
+  const MatrixQ f;
+};
+
+}  // namespace
+
+// Arguments: rank of both groups, prime, largest torsion exponent.
+static void BM_ComputeKernel(benchmark::State& state)
+{
+  const MorphismInput in(state);
+  MatrixQList from_X = {MatrixQ::identity(in.X.rank())};
+
+  for (auto _ : state) {
+    GroupWithMorphisms K = compute_kernel(in.p, in.f, in.X, in.Y,
+                                          MatrixQRefList(), ref(from_X));
+    benchmark::DoNotOptimize(&K);
+  }
+}
+BENCHMARK(BM_ComputeKernel)
+    ->ArgsProduct({{8, 32}, {2, 3, 101}, {1, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ComputeCokernel(benchmark::State& state)
+{
+  const MorphismInput in(state);
+  MatrixQList to_Y = {MatrixQ::identity(in.Y.rank())};
+
+  for (auto _ : state) {
+    GroupWithMorphisms C =
+        compute_cokernel(in.p, in.f, in.Y, ref(to_Y), MatrixQRefList());
+    benchmark::DoNotOptimize(&C);
+  }
+}
+BENCHMARK(BM_ComputeCokernel)
+    ->ArgsProduct({{8, 32}, {2, 3, 101}, {1, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ComputeKernelArena(benchmark::State& state)
+{
+  const MorphismInput in(state);
+  MatrixQList from_X = {MatrixQ::identity(in.X.rank())};
+
+  set_morphism_arenas(true);
+  for (auto _ : state) {
+    GroupWithMorphisms K = compute_kernel(in.p, in.f, in.X, in.Y,
+                                          MatrixQRefList(), ref(from_X));
+    benchmark::DoNotOptimize(&K);
+  }
+  set_morphism_arenas(false);
+}
+BENCHMARK(BM_ComputeKernelArena)
+    ->ArgsProduct({{8, 32}, {2, 3, 101}, {1, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+// A chain of cokernels, each by a random map of rank 2 into the previous one,
+// as along the pages of a spectral sequence. Arguments: rank, prime, largest
+// torsion exponent, whether maps are reduced modulo the orders.
+static void BM_CokernelPages(benchmark::State& state)
+{
+  const MorphismInput in(state);
+  const std::size_t pages = in.Y.rank() / 2;
+
+  set_morphism_reduction(state.range(3) != 0);
+  for (auto _ : state) {
+    std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(state.range(0)));
+    // Groups cannot be assigned, so the whole chain is kept.
+    std::vector<AbelianGroup> C = {in.Y};
+    MatrixQList to_C = {MatrixQ::identity(in.Y.rank())};
+
+    for (std::size_t page = 0; page < pages; ++page) {
+      const AbelianGroup X = random_group(
+          rng, 1, static_cast<std::size_t>(state.range(2)));
+      const MatrixQ f = random_morphism(rng, in.p, X, C.back(), 50);
+      GroupWithMorphisms next =
+          compute_cokernel(in.p, f, C.back(), ref(to_C), MatrixQRefList());
+      C.push_back(next.group);
+      to_C.swap(next.maps_to);
+    }
+    benchmark::DoNotOptimize(&to_C);
+  }
+  set_morphism_reduction(true);
+}
+BENCHMARK(BM_CokernelPages)
+    ->ArgsProduct({{32}, {3, 101}, {4}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: rank of both groups, prime, largest torsion exponent, requested
+// maps as in MapRequest.
+static void BM_ComputeImage(benchmark::State& state)
+{
+  const MorphismInput in(state);
+  const MapRequest request = static_cast<MapRequest>(state.range(3));
+
+  for (auto _ : state) {
+    GroupWithMorphisms I = compute_image(in.p, in.f, in.X, in.Y, request);
+    benchmark::DoNotOptimize(&I);
+  }
+}
+BENCHMARK(BM_ComputeImage)
+    ->ArgsProduct({{32, 64}, {3, 101}, {4}, {0, 3}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,125 @@
+#include "benchmark/benchmark.h"
+
+#include "generators.h"
+#include "smith.h"
+#include "sparse_matrix.h"
+
+namespace {
+
+std::uint64_t seed(const benchmark::State& state)
+{
+  return static_cast<std::uint64_t>(state.range(0) * 1000003 +
+                                    state.range(1) * 1009 + state.range(2));
+}
+
+}  // namespace
+
+// Arguments: size, density in percent, prime. The transforms are tracked.
+static void BM_SmithReduceP(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  const std::size_t p = static_cast<std::size_t>(state.range(2));
+  std::mt19937_64 rng = bench_rng(seed(state));
+  const MatrixQ f_orig = random_matrix(rng, n, n, state.range(1));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    MatrixQ f = f_orig;
+    MatrixQList to_X = {MatrixQ::identity(n)};
+    MatrixQList to_Y = {MatrixQ::identity(n)};
+    MatrixQRefList to_X_ref = ref(to_X);
+    MatrixQRefList to_Y_ref = ref(to_Y);
+    MatrixQRefList from_X_ref;
+    MatrixQRefList from_Y_ref;
+    state.ResumeTiming();
+
+    smith_reduce_p(p, f, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+    benchmark::DoNotOptimize(&f);
+  }
+}
+BENCHMARK(BM_SmithReduceP)
+    ->ArgsProduct({{16, 48}, {10, 100}, {2, 3, 101}})
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: size, fraction-free mode. Dense, with p = 3 and the transforms
+// tracked.
+static void BM_SmithReducePFractionFree(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  // Both modes reduce the same matrix.
+  std::mt19937_64 rng = bench_rng(static_cast<std::uint64_t>(n));
+  const MatrixQ f_orig = random_matrix(rng, n, n, 100);
+
+  const bool fraction_free = smith_fraction_free();
+  set_smith_fraction_free(state.range(1) != 0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    MatrixQ f = f_orig;
+    MatrixQList to_X = {MatrixQ::identity(n)};
+    MatrixQList to_Y = {MatrixQ::identity(n)};
+    MatrixQRefList to_X_ref = ref(to_X);
+    MatrixQRefList to_Y_ref = ref(to_Y);
+    MatrixQRefList from_X_ref;
+    MatrixQRefList from_Y_ref;
+    state.ResumeTiming();
+
+    smith_reduce_p(3, f, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+    benchmark::DoNotOptimize(&f);
+  }
+  set_smith_fraction_free(fraction_free);
+}
+BENCHMARK(BM_SmithReducePFractionFree)
+    ->ArgsProduct({{48, 96, 160}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SmithReducePSparse(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  const std::size_t p = static_cast<std::size_t>(state.range(2));
+  std::mt19937_64 rng = bench_rng(seed(state));
+  const SparseMatrixQ f_orig(random_matrix(rng, n, n, state.range(1)));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    SparseMatrixQ f = f_orig;
+    MatrixQRefList to_X_ref;
+    MatrixQRefList from_X_ref;
+    MatrixQRefList to_Y_ref;
+    MatrixQRefList from_Y_ref;
+    state.ResumeTiming();
+
+    smith_reduce_p(p, f, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+    benchmark::DoNotOptimize(&f);
+  }
+}
+BENCHMARK(BM_SmithReducePSparse)
+    ->ArgsProduct({{64, 256}, {2, 10}, {2, 3, 101}})
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: size, entries per row, prime. No transforms are tracked, so the
+// time is that of the pivot search and the eliminations alone, which should
+// grow about linearly with the size at this sparsity.
+static void BM_SmithReducePSparseLarge(benchmark::State& state)
+{
+  const std::size_t n = static_cast<std::size_t>(state.range(0));
+  const std::size_t p = static_cast<std::size_t>(state.range(2));
+  std::mt19937_64 rng = bench_rng(seed(state));
+  const SparseMatrixQ f_orig = random_sparse_matrix(
+      rng, n, n, static_cast<std::size_t>(state.range(1)));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    SparseMatrixQ f = f_orig;
+    MatrixQRefList to_X_ref;
+    MatrixQRefList from_X_ref;
+    MatrixQRefList to_Y_ref;
+    MatrixQRefList from_Y_ref;
+    state.ResumeTiming();
+
+    smith_reduce_p(p, f, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+    benchmark::DoNotOptimize(&f);
+  }
+}
+BENCHMARK(BM_SmithReducePSparseLarge)
+    ->ArgsProduct({{4000, 16000}, {2}, {3}})
+    ->Unit(benchmark::kMillisecond);
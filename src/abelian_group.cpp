@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <gmpxx.h>
 
 #include "abelian_group.h"
@@ -13,6 +15,13 @@ AbelianGroup::AbelianGroup(const std::size_t free_rank,
 {
 }
 
+OrderExponent AbelianGroup::max_order() const
+{
+  if (orders_.empty()) return 0;
+
+  return *std::max_element(orders_.begin(), orders_.end());
+}
+
 template <>
 AbelianGroup::TorsionMatrix<mpq_class>::TorsionMatrix(const AbelianGroup& group,
                                                       const std::size_t p)
@@ -10,7 +10,7 @@ typedef std::size_t OrderExponent;
 class AbelianGroup
 {
   template <typename T>
-  class TorsionMatrix : public MatrixExpression<T, TorsionMatrix>
+  class TorsionMatrix : public MatrixExpression<T, TorsionMatrix<T>>
   {
    public:
     TorsionMatrix(const AbelianGroup& group, const std::size_t p);
@@ -54,6 +54,8 @@ class AbelianGroup
 	  return free_rank() + tor_rank();
   }
 
+  OrderExponent max_order() const;
+
   TorsionMatrix<mpq_class> torsion_matrix(const std::size_t p) const;
 
  private:
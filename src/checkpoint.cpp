@@ -0,0 +1,404 @@
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+const char MAGIC[8] = {'A', 'K', 'S', 'S', 'C', 'K', 'P', 'T'};
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+class Encoder
+{
+ public:
+  explicit Encoder(std::vector<char>& out) : out_(out)
+  {
+  }
+
+  template <typename T>
+  void put(const T& x)
+  {
+    const char* bytes = reinterpret_cast<const char*>(&x);
+    out_.insert(out_.end(), bytes, bytes + sizeof(T));
+  }
+
+  void put_mpz(mpz_srcptr z)
+  {
+    const std::size_t limbs = mpz_size(z);
+    put(static_cast<std::int64_t>(mpz_sgn(z) < 0 ? -static_cast<long>(limbs)
+                                                   : static_cast<long>(limbs)));
+
+    const char* bytes = reinterpret_cast<const char*>(mpz_limbs_read(z));
+    out_.insert(out_.end(), bytes, bytes + limbs * sizeof(mp_limb_t));
+  }
+
+  void put_index(const TrigradedIndex& pqs)
+  {
+    put(static_cast<std::int32_t>(pqs.p()));
+    put(static_cast<std::int32_t>(pqs.q()));
+    put(static_cast<std::int32_t>(pqs.s()));
+  }
+
+  void put_group(const AbelianGroup& grp)
+  {
+    put(static_cast<std::uint64_t>(grp.free_rank()));
+    put(static_cast<std::uint64_t>(grp.tor_rank()));
+    for (std::size_t i = 0; i < grp.tor_rank(); ++i) {
+      put(static_cast<std::uint64_t>(grp(i)));
+    }
+  }
+
+  void put_matrix(const MatrixQ& f)
+  {
+    put(static_cast<std::uint64_t>(f.height()));
+    put(static_cast<std::uint64_t>(f.width()));
+    for (std::size_t i = 0; i < f.height(); ++i) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        const mpq_class& x = f(i, j);
+        put_mpz(x.get_num_mpz_t());
+        put_mpz(x.get_den_mpz_t());
+      }
+    }
+  }
+
+ private:
+  std::vector<char>& out_;
+};
+
+class Decoder
+{
+ public:
+  Decoder(const char* data, const std::size_t size)
+      : pos_(data), end_(data + size)
+  {
+  }
+
+  template <typename T>
+  T get()
+  {
+    T x;
+    std::memcpy(&x, take(sizeof(T)), sizeof(T));
+    return x;
+  }
+
+  void get_mpz(mpz_ptr z)
+  {
+    const std::int64_t size = get<std::int64_t>();
+    const std::size_t limbs =
+        static_cast<std::size_t>(size < 0 ? -size : size);
+    const char* bytes = take(limbs * sizeof(mp_limb_t));
+
+    if (!limbs) {
+      mpz_set_ui(z, 0);
+      return;
+    }
+
+    std::memcpy(mpz_limbs_write(z, static_cast<mp_size_t>(limbs)), bytes,
+                limbs * sizeof(mp_limb_t));
+    mpz_limbs_finish(z, static_cast<mp_size_t>(size));
+  }
+
+  TrigradedIndex get_index()
+  {
+    const int p = get<std::int32_t>();
+    const int q = get<std::int32_t>();
+    const int s = get<std::int32_t>();
+    return TrigradedIndex(p, q, s);
+  }
+
+  AbelianGroup get_group()
+  {
+    const std::size_t free_rank = get_size();
+    AbelianGroup grp(free_rank, get_size());
+    for (std::size_t i = 0; i < grp.tor_rank(); ++i) {
+      grp(i) = get_size();
+    }
+    return grp;
+  }
+
+  MatrixQ get_matrix()
+  {
+    const std::size_t height = get_size();
+    MatrixQ f(height, get_size());
+    for (std::size_t i = 0; i < f.height(); ++i) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        mpq_class& x = f(i, j);
+        get_mpz(x.get_num_mpz_t());
+        get_mpz(x.get_den_mpz_t());
+      }
+    }
+    return f;
+  }
+
+  std::size_t get_size()
+  {
+    return static_cast<std::size_t>(get<std::uint64_t>());
+  }
+
+  const char* take(const std::size_t bytes)
+  {
+    if (static_cast<std::size_t>(end_ - pos_) < bytes)
+      throw std::logic_error("Checkpoint::load: file is truncated");
+
+    const char* data = pos_;
+    pos_ += bytes;
+    return data;
+  }
+
+  bool at_end() const
+  {
+    return pos_ == end_;
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+void put_sequence(Encoder& out,
+                  const std::map<std::size_t,
+                                 std::tuple<AbelianGroup, MatrixQ>>& entries,
+                  const bool done, const std::size_t current)
+{
+  out.put(static_cast<std::uint8_t>(done));
+  out.put(static_cast<std::uint64_t>(current));
+  out.put(static_cast<std::uint64_t>(entries.size()));
+  for (const auto& entry : entries) {
+    out.put(static_cast<std::uint64_t>(entry.first));
+    out.put_group(std::get<0>(entry.second));
+    out.put_matrix(std::get<1>(entry.second));
+  }
+}
+
+}  // namespace
+
+const std::uint32_t Checkpoint::VERSION;
+
+std::vector<char> Checkpoint::serialize(const SpectralSequence& spec)
+{
+  std::vector<char> data;
+  Encoder out(data);
+
+  data.insert(data.end(), MAGIC, MAGIC + sizeof(MAGIC));
+  out.put(VERSION);
+  out.put(static_cast<std::uint32_t>(sizeof(mp_limb_t)));
+  out.put(BYTE_ORDER_MARK);
+  out.put(static_cast<std::uint64_t>(spec.prime_));
+
+  for (const auto* sequences : {&spec.kernels_, &spec.cokernels_}) {
+    out.put(static_cast<std::uint64_t>(sequences->size()));
+    for (const auto& entry : *sequences) {
+      const GroupSequence& seq = entry.second;
+      out.put_index(entry.first);
+      put_sequence(out, seq.entries_, seq.done_, seq.current_);
+    }
+  }
+
+  out.put(static_cast<std::uint64_t>(spec.differentials_.size()));
+  for (const auto& entry : spec.differentials_) {
+    out.put_index(entry.first);
+    out.put(static_cast<std::uint64_t>(entry.second.size()));
+    for (const MatrixQ& f : entry.second) out.put_matrix(f);
+  }
+
+  return data;
+}
+
+SpectralSequence Checkpoint::deserialize(const char* data,
+                                         const std::size_t size)
+{
+  Decoder in(data, size);
+
+  if (std::memcmp(in.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0)
+    throw std::logic_error("Checkpoint::load: not a checkpoint");
+  if (in.get<std::uint32_t>() != VERSION)
+    throw std::logic_error("Checkpoint::load: unsupported version");
+  if (in.get<std::uint32_t>() != sizeof(mp_limb_t) ||
+      in.get<std::uint32_t>() != BYTE_ORDER_MARK)
+    throw std::logic_error(
+        "Checkpoint::load: written on an incompatible architecture");
+
+  SpectralSequence spec(in.get_size());
+
+  for (auto* sequences : {&spec.kernels_, &spec.cokernels_}) {
+    const std::size_t count = in.get_size();
+    for (std::size_t k = 0; k < count; ++k) {
+      const TrigradedIndex pqs = in.get_index();
+      const bool done = in.get<std::uint8_t>() != 0;
+      const std::size_t current = in.get_size();
+      const std::size_t entries = in.get_size();
+      if (!entries)
+        throw std::logic_error("Checkpoint::load: empty group sequence");
+
+      const std::size_t index_min = in.get_size();
+      const AbelianGroup grp = in.get_group();
+      GroupSequence seq(index_min, grp);
+      std::get<1>(seq.entries_.begin()->second) = in.get_matrix();
+
+      for (std::size_t e = 1; e < entries; ++e) {
+        const std::size_t index = in.get_size();
+        const AbelianGroup entry_grp = in.get_group();
+        seq.entries_.emplace(index,
+                             std::make_tuple(entry_grp, in.get_matrix()));
+      }
+
+      seq.done_ = done;
+      seq.current_ = current;
+      sequences->emplace(pqs, seq);
+    }
+  }
+
+  const std::size_t count = in.get_size();
+  for (std::size_t k = 0; k < count; ++k) {
+    const TrigradedIndex pqs = in.get_index();
+    MatrixQList& diffs = spec.differentials_[pqs];
+    const std::size_t matrices = in.get_size();
+    for (std::size_t m = 0; m < matrices; ++m) {
+      diffs.push_back(in.get_matrix());
+    }
+  }
+
+  if (!in.at_end())
+    throw std::logic_error("Checkpoint::load: trailing data");
+
+  return spec;
+}
+
+void Checkpoint::save(const SpectralSequence& spec, const std::string& path)
+{
+  write(serialize(spec), path);
+}
+
+void Checkpoint::write(const std::vector<char>& data, const std::string& path)
+{
+  const std::string tmp_path = path + ".tmp";
+
+  // The data reaches the disk before the rename, and the rename before write
+  // returns, so a crash leaves either the previous checkpoint or the new one.
+  const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Checkpoint::save: cannot write " + tmp_path);
+
+  std::size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += static_cast<std::size_t>(n);
+  }
+  const bool synced = written == data.size() && fsync(fd) == 0;
+  if (close(fd) != 0 || !synced)
+    throw std::runtime_error("Checkpoint::save: cannot write " + tmp_path);
+
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Checkpoint::save: cannot replace " + path);
+
+  const std::size_t slash = path.rfind('/');
+  const std::string dir =
+      slash == std::string::npos ? "." : path.substr(0, slash ? slash : 1);
+  const int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0)
+    throw std::runtime_error("Checkpoint::save: cannot open " + dir);
+  const bool dir_synced = fsync(dir_fd) == 0;
+  close(dir_fd);
+  if (!dir_synced)
+    throw std::runtime_error("Checkpoint::save: cannot sync " + dir);
+}
+
+SpectralSequence Checkpoint::load(const std::string& path)
+{
+  MappedFile file(path);
+
+  return deserialize(file.data(), file.size());
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path,
+                                   const std::chrono::seconds interval)
+    : path_(path),
+      interval_(interval),
+      last_save_(std::chrono::steady_clock::now()),
+      has_pending_(false),
+      writing_(false),
+      stop_(false),
+      thread_(&CheckpointWriter::work, this)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+void CheckpointWriter::save(const SpectralSequence& spec)
+{
+  std::vector<char> data = Checkpoint::serialize(spec);
+  last_save_ = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.swap(data);
+    has_pending_ = true;
+  }
+  changed_.notify_all();
+}
+
+bool CheckpointWriter::save_if_due(const SpectralSequence& spec)
+{
+  if (std::chrono::steady_clock::now() - last_save_ < interval_) return false;
+
+  save(spec);
+  return true;
+}
+
+void CheckpointWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return !has_pending_ && !writing_; });
+
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void CheckpointWriter::work()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    changed_.wait(lock, [this] { return stop_ || has_pending_; });
+    // Snapshots still pending on destruction are written before exiting.
+    if (!has_pending_) return;
+
+    std::vector<char> data;
+    data.swap(pending_);
+    has_pending_ = false;
+    writing_ = true;
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      Checkpoint::write(data, path_);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    writing_ = false;
+    if (error && !error_) error_ = error;
+    changed_.notify_all();
+  }
+}
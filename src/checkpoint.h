@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spectral_sequence.h"
+
+// Binary snapshots of a SpectralSequence.
+//
+// The format stores the group sequences and differentials of every index,
+// with rational entries as the raw GMP limbs of numerator and denominator. It
+// is tied to the limb size and byte order of the writing machine, both of
+// which are recorded in the header and checked on load.
+class Checkpoint
+{
+ public:
+  static const std::uint32_t VERSION = 1;
+
+  static std::vector<char> serialize(const SpectralSequence& spec);
+  static SpectralSequence deserialize(const char* data, const std::size_t size);
+
+  // Writes to a temporary file next to path, which then replaces path. The file
+  // and its directory are synced first, so after a crash path holds either the
+  // previous checkpoint or the complete new one.
+  static void save(const SpectralSequence& spec, const std::string& path);
+  static void write(const std::vector<char>& data, const std::string& path);
+  // Reads the file through a read-only memory mapping.
+  static SpectralSequence load(const std::string& path);
+};
+
+// Writes checkpoints on a background thread.
+//
+// Only the serialization into memory happens on the calling thread; the
+// computation continues while the snapshot goes to disk. If a new snapshot
+// arrives before the previous one was written, the previous one is dropped.
+class CheckpointWriter
+{
+ public:
+  CheckpointWriter(const std::string& path,
+                   const std::chrono::seconds interval);
+  ~CheckpointWriter();
+
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  void save(const SpectralSequence& spec);
+  // Saves if the interval passed since the last save. Returns whether it did.
+  bool save_if_due(const SpectralSequence& spec);
+  // Blocks until all snapshots are written, and rethrows the first error.
+  void wait();
+
+ private:
+  void work();
+
+  const std::string path_;
+  const std::chrono::seconds interval_;
+  std::chrono::steady_clock::time_point last_save_;
+
+  std::vector<char> pending_;
+  bool has_pending_;
+  bool writing_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+};
@@ -0,0 +1,176 @@
+#include "counters.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include <gmp.h>
+
+namespace {
+
+const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+    "row_add", "row_mul",       "row_swap",        "col_add",  "col_mul",
+    "col_swap", "p_val_q", "pivot_steps", "gmp_allocations", "gmp_bytes"};
+
+std::atomic<std::uint64_t>* totals()
+{
+  static std::atomic<std::uint64_t> values[COUNTER_COUNT];
+  return values;
+}
+
+std::mutex& calls_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::deque<CounterCall>& calls()
+{
+  static std::deque<CounterCall> list;
+  return list;
+}
+
+// Number of calls and their summed counts, for every function name.
+typedef std::map<std::string, std::pair<std::size_t, CounterValues>>
+    CounterSums;
+
+CounterSums& sums()
+{
+  static CounterSums map;
+  return map;
+}
+
+#ifdef AKSS_COUNTERS
+
+void* (*gmp_alloc)(std::size_t);
+void* (*gmp_realloc)(void*, std::size_t, std::size_t);
+void (*gmp_free)(void*, std::size_t);
+
+void* counting_alloc(std::size_t size)
+{
+  counter_add(Counter::GmpAllocations, 1);
+  counter_add(Counter::GmpBytes, size);
+  return gmp_alloc(size);
+}
+
+void* counting_realloc(void* ptr, std::size_t old_size, std::size_t new_size)
+{
+  counter_add(Counter::GmpAllocations, 1);
+  if (new_size > old_size) counter_add(Counter::GmpBytes, new_size - old_size);
+  return gmp_realloc(ptr, old_size, new_size);
+}
+
+void dump_at_exit()
+{
+  const char* target = std::getenv("AKSS_COUNTERS_DUMP");
+  if (!target) return;
+
+  if (std::string(target) == "-") {
+    dump_counters(std::cerr);
+  } else {
+    std::ofstream file(target);
+    dump_counters(file);
+  }
+}
+
+// Counts GMP allocations from the start, and arranges for the dump at exit.
+struct CounterSetup {
+  CounterSetup()
+  {
+    mp_get_memory_functions(&gmp_alloc, &gmp_realloc, &gmp_free);
+    mp_set_memory_functions(counting_alloc, counting_realloc, gmp_free);
+
+    // Statics constructed before registering the handler outlive it.
+    totals();
+    calls_mutex();
+    calls();
+    sums();
+    std::atexit(dump_at_exit);
+  }
+} counter_setup;
+
+#endif
+
+void write_values(std::ostream& stream, const CounterValues& values)
+{
+  for (std::size_t k = 0; k < COUNTER_COUNT; ++k) {
+    stream << " " << COUNTER_NAMES[k] << "=" << values[k];
+  }
+  stream << "\n";
+}
+
+}  // namespace
+
+const char* counter_name(const Counter counter)
+{
+  return COUNTER_NAMES[static_cast<std::size_t>(counter)];
+}
+
+void counter_add(const Counter counter, const std::uint64_t n)
+{
+  totals()[static_cast<std::size_t>(counter)].fetch_add(
+      n, std::memory_order_relaxed);
+}
+
+CounterValues counter_totals()
+{
+  CounterValues values;
+  for (std::size_t k = 0; k < COUNTER_COUNT; ++k) {
+    values[k] = totals()[k].load(std::memory_order_relaxed);
+  }
+  return values;
+}
+
+std::vector<CounterCall> counter_calls()
+{
+  std::lock_guard<std::mutex> lock(calls_mutex());
+  return std::vector<CounterCall>(calls().begin(), calls().end());
+}
+
+void reset_counters()
+{
+  std::lock_guard<std::mutex> lock(calls_mutex());
+  for (std::size_t k = 0; k < COUNTER_COUNT; ++k) totals()[k] = 0;
+  calls().clear();
+  sums().clear();
+}
+
+void dump_counters(std::ostream& stream)
+{
+  CounterSums per_name;
+  {
+    std::lock_guard<std::mutex> lock(calls_mutex());
+    per_name = sums();
+  }
+
+  stream << "total:";
+  write_values(stream, counter_totals());
+  for (const auto& entry : per_name) {
+    stream << entry.first << " (" << entry.second.first << " calls):";
+    write_values(stream, entry.second.second);
+  }
+  stream << std::flush;
+}
+
+CounterScope::CounterScope(const char* name)
+    : name_(name), start_(counter_totals())
+{
+}
+
+CounterScope::~CounterScope()
+{
+  CounterValues counts = counter_totals();
+  for (std::size_t k = 0; k < COUNTER_COUNT; ++k) counts[k] -= start_[k];
+
+  std::lock_guard<std::mutex> lock(calls_mutex());
+  std::pair<std::size_t, CounterValues>& sum = sums()[name_];
+  if (!sum.first) sum.second.fill(0);
+  ++sum.first;
+  for (std::size_t k = 0; k < COUNTER_COUNT; ++k) sum.second[k] += counts[k];
+
+  if (calls().size() == COUNTER_HISTORY) calls().pop_front();
+  calls().push_back(CounterCall{name_, counts});
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Event counters for the elementary operations of the reductions and the
+// memory GMP allocates. They are only compiled in if AKSS_COUNTERS is defined
+// (cmake -DAKSS_COUNTERS=ON); otherwise the macros below expand to nothing and
+// all queries return zeros.
+//
+// Counts are process-wide. The breakdown per call attributes everything
+// counted between entering and leaving the call, which includes work of other
+// threads running at the same time.
+
+enum class Counter {
+  RowAdd,
+  RowMul,
+  RowSwap,
+  ColAdd,
+  ColMul,
+  ColSwap,
+  PValQ,
+  PivotSteps,
+  GmpAllocations,
+  GmpBytes,
+};
+
+const std::size_t COUNTER_COUNT = 10;
+
+typedef std::array<std::uint64_t, COUNTER_COUNT> CounterValues;
+
+struct CounterCall {
+  std::string name;
+  CounterValues counts;
+};
+
+const char* counter_name(const Counter counter);
+
+void counter_add(const Counter counter, const std::uint64_t n);
+
+// Completed calls to instrumented functions kept individually. Older calls
+// only remain in the totals per function name.
+const std::size_t COUNTER_HISTORY = 1024;
+
+CounterValues counter_totals();
+// Counts of the last COUNTER_HISTORY completed calls to instrumented
+// functions, in order of completion.
+std::vector<CounterCall> counter_calls();
+void reset_counters();
+
+// Writes the totals and the totals per function name. At exit this happens
+// automatically if the environment variable AKSS_COUNTERS_DUMP is set, to the
+// file it names or to stderr for "-".
+void dump_counters(std::ostream& stream);
+
+// Records the counts of the enclosing call under name.
+class CounterScope
+{
+ public:
+  explicit CounterScope(const char* name);
+  ~CounterScope();
+
+  CounterScope(const CounterScope&) = delete;
+  CounterScope& operator=(const CounterScope&) = delete;
+
+ private:
+  const char* name_;
+  CounterValues start_;
+};
+
+#ifdef AKSS_COUNTERS
+#define AKSS_COUNT(counter) counter_add(Counter::counter, 1)
+#define AKSS_COUNT_N(counter, n) counter_add(Counter::counter, (n))
+#define AKSS_COUNTER_SCOPE(name) CounterScope akss_counter_scope_(name)
+#else
+#define AKSS_COUNT(counter) static_cast<void>(0)
+#define AKSS_COUNT_N(counter, n) static_cast<void>(0)
+#define AKSS_COUNTER_SCOPE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,248 @@
+#include "gmp_arena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <gmp.h>
+
+#include "counters.h"
+
+namespace {
+
+// Chunks are aligned to their size, so the owner of a pointer is found by
+// looking up its chunk index in a two-level table covering 48-bit addresses.
+const std::size_t CHUNK_BITS = 20;
+const std::size_t CHUNK_SIZE = std::size_t(1) << CHUNK_BITS;
+const std::size_t LEAF_BITS = 14;
+const std::size_t ROOT_BITS = 14;
+const std::size_t MIN_BLOCK = 16;
+const std::size_t MAX_SPARE_CHUNKS = 4;
+
+typedef std::atomic<GmpArena*> OwnerSlot;
+
+OwnerSlot* owner_leaf(const std::uintptr_t index, const bool create)
+{
+  static std::atomic<OwnerSlot*> root[std::size_t(1) << ROOT_BITS];
+
+  std::atomic<OwnerSlot*>& entry = root[index >> LEAF_BITS];
+  OwnerSlot* leaf = entry.load(std::memory_order_acquire);
+  if (leaf || !create) return leaf;
+
+  OwnerSlot* fresh = new OwnerSlot[std::size_t(1) << LEAF_BITS]();
+  if (entry.compare_exchange_strong(leaf, fresh)) return fresh;
+
+  delete[] fresh;
+  return leaf;
+}
+
+GmpArena* chunk_owner(const void* ptr)
+{
+  const std::uintptr_t index =
+      reinterpret_cast<std::uintptr_t>(ptr) >> CHUNK_BITS;
+  if (index >> (ROOT_BITS + LEAF_BITS)) return nullptr;
+
+  OwnerSlot* leaf = owner_leaf(index, false);
+  if (!leaf) return nullptr;
+
+  return leaf[index & ((std::size_t(1) << LEAF_BITS) - 1)].load(
+      std::memory_order_acquire);
+}
+
+bool set_chunk_owner(const void* chunk, GmpArena* owner)
+{
+  const std::uintptr_t index =
+      reinterpret_cast<std::uintptr_t>(chunk) >> CHUNK_BITS;
+  if (index >> (ROOT_BITS + LEAF_BITS)) return false;
+
+  OwnerSlot* leaf = owner_leaf(index, true);
+  leaf[index & ((std::size_t(1) << LEAF_BITS) - 1)].store(
+      owner, std::memory_order_release);
+  return true;
+}
+
+// Blocks of size class k hold MIN_BLOCK << k bytes. Returns SIZE_CLASSES for
+// sizes too large for the arena.
+std::size_t size_class(const std::size_t size, const std::size_t classes)
+{
+  std::size_t k = 0;
+  while (k < classes && (MIN_BLOCK << k) < size) ++k;
+  return k;
+}
+
+// Chunks of destroyed arenas kept for the next arena on the same thread, so
+// that short computations do not map and unmap a chunk each.
+struct SpareChunks {
+  ~SpareChunks()
+  {
+    for (char* chunk : chunks) std::free(chunk);
+  }
+
+  std::vector<char*> chunks;
+};
+
+thread_local SpareChunks spare_chunks;
+
+char* new_chunk()
+{
+  if (!spare_chunks.chunks.empty()) {
+    char* chunk = spare_chunks.chunks.back();
+    spare_chunks.chunks.pop_back();
+    return chunk;
+  }
+
+  void* chunk;
+  if (posix_memalign(&chunk, CHUNK_SIZE, CHUNK_SIZE)) return nullptr;
+  return static_cast<char*>(chunk);
+}
+
+void release_chunk(char* chunk)
+{
+  if (spare_chunks.chunks.size() < MAX_SPARE_CHUNKS)
+    spare_chunks.chunks.push_back(chunk);
+  else
+    std::free(chunk);
+}
+
+void* (*heap_allocate)(std::size_t);
+void* (*heap_reallocate)(void*, std::size_t, std::size_t);
+void (*heap_free)(void*, std::size_t);
+
+std::once_flag install_flag;
+
+}  // namespace
+
+thread_local GmpArena* GmpArena::current_ = nullptr;
+
+GmpArena::GmpArena() : next_(nullptr), end_(nullptr)
+{
+  for (std::size_t k = 0; k < SIZE_CLASSES; ++k) free_lists_[k] = nullptr;
+
+  install();
+}
+
+GmpArena::~GmpArena()
+{
+  for (char* chunk : chunks_) {
+    set_chunk_owner(chunk, nullptr);
+    release_chunk(chunk);
+  }
+}
+
+GmpArena::Scope::Scope(GmpArena& arena) : previous_(current_)
+{
+  current_ = &arena;
+}
+
+GmpArena::Scope::~Scope()
+{
+  current_ = previous_;
+}
+
+GmpArena::Suspend::Suspend() : previous_(current_)
+{
+  current_ = nullptr;
+}
+
+GmpArena::Suspend::~Suspend()
+{
+  current_ = previous_;
+}
+
+void GmpArena::install()
+{
+  std::call_once(install_flag, []() {
+    mp_get_memory_functions(&heap_allocate, &heap_reallocate, &heap_free);
+    mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_free);
+  });
+}
+
+bool GmpArena::owns(const void* ptr) const
+{
+  return chunk_owner(ptr) == this;
+}
+
+std::size_t GmpArena::reserved() const
+{
+  return chunks_.size() * CHUNK_SIZE;
+}
+
+void* GmpArena::allocate(const std::size_t k)
+{
+  if (free_lists_[k]) {
+    void* block = free_lists_[k];
+    free_lists_[k] = *static_cast<void**>(block);
+    return block;
+  }
+
+  const std::size_t size = MIN_BLOCK << k;
+  if (static_cast<std::size_t>(end_ - next_) < size) {
+    char* chunk = new_chunk();
+    if (!chunk) return nullptr;
+    if (!set_chunk_owner(chunk, this)) {
+      release_chunk(chunk);
+      return nullptr;
+    }
+
+    chunks_.push_back(chunk);
+    next_ = chunks_.back();
+    end_ = next_ + CHUNK_SIZE;
+  }
+
+  void* block = next_;
+  next_ += size;
+  return block;
+}
+
+void GmpArena::deallocate(void* ptr, const std::size_t k)
+{
+  *static_cast<void**>(ptr) = free_lists_[k];
+  free_lists_[k] = ptr;
+}
+
+void* GmpArena::gmp_allocate(const std::size_t size)
+{
+  GmpArena* arena = current_;
+  const std::size_t k = size_class(size, SIZE_CLASSES);
+  if (arena && k < SIZE_CLASSES) {
+    void* block = arena->allocate(k);
+    if (block) {
+      AKSS_COUNT(GmpAllocations);
+      AKSS_COUNT_N(GmpBytes, size);
+      return block;
+    }
+  }
+
+  return heap_allocate(size);
+}
+
+void* GmpArena::gmp_reallocate(void* ptr, const std::size_t old_size,
+                               const std::size_t new_size)
+{
+  GmpArena* owner = chunk_owner(ptr);
+  if (!owner) return heap_reallocate(ptr, old_size, new_size);
+
+  // The size GMP passes may be smaller than the block, never larger.
+  const std::size_t k = size_class(old_size, SIZE_CLASSES);
+  if (owner == current_ && size_class(new_size, SIZE_CLASSES) <= k) {
+    AKSS_COUNT(GmpAllocations);
+    return ptr;
+  }
+
+  void* moved = gmp_allocate(new_size);
+  std::memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+  gmp_free(ptr, old_size);
+  return moved;
+}
+
+void GmpArena::gmp_free(void* ptr, const std::size_t size)
+{
+  GmpArena* owner = chunk_owner(ptr);
+  if (!owner)
+    heap_free(ptr, size);
+  else if (owner == current_)
+    owner->deallocate(ptr, size_class(size, SIZE_CLASSES));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Region allocator for GMP temporaries.
+//
+// While a GmpArena::Scope is active on a thread, memory GMP allocates on that
+// thread is carved out of the arena's chunks instead of coming from malloc,
+// and all of it is released at once when the arena is destroyed. Freed blocks
+// are recycled through per-size free lists in the meantime. Every value that
+// has to outlive the arena must therefore be copied while no arena is active,
+// e.g. under a GmpArena::Suspend.
+//
+// The allocation functions of GMP are replaced (via mp_set_memory_functions)
+// by install(), at the latest when the first arena is created, and forward to
+// the previous ones for memory not owned by an arena. No other thread may be
+// using GMP at that moment. Blocks owned by an arena can be freed or
+// reallocated on any thread; on threads other than the one the arena is active
+// on, freeing is a no-op and reallocating moves the value out of the arena.
+//
+// An arena must only be active on one thread at a time.
+class GmpArena
+{
+ public:
+  GmpArena();
+  ~GmpArena();
+
+  GmpArena(const GmpArena&) = delete;
+  GmpArena& operator=(const GmpArena&) = delete;
+
+  // Directs GMP allocations of the calling thread to arena.
+  class Scope
+  {
+   public:
+    explicit Scope(GmpArena& arena);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    GmpArena* previous_;
+  };
+
+  // Directs GMP allocations of the calling thread back to the heap.
+  class Suspend
+  {
+   public:
+    Suspend();
+    ~Suspend();
+
+    Suspend(const Suspend&) = delete;
+    Suspend& operator=(const Suspend&) = delete;
+
+   private:
+    GmpArena* previous_;
+  };
+
+  // Installs the allocation functions. Only the first call has an effect.
+  static void install();
+
+  // Whether ptr points into one of the chunks of this arena.
+  bool owns(const void* ptr) const;
+
+  // Bytes held in chunks.
+  std::size_t reserved() const;
+
+ private:
+  static const std::size_t SIZE_CLASSES = 13;
+
+  static void* gmp_allocate(std::size_t size);
+  static void* gmp_reallocate(void* ptr, std::size_t old_size,
+                              std::size_t new_size);
+  static void gmp_free(void* ptr, std::size_t size);
+
+  void* allocate(const std::size_t size_class);
+  void deallocate(void* ptr, const std::size_t size_class);
+
+  std::vector<char*> chunks_;
+  char* next_;
+  char* end_;
+  void* free_lists_[SIZE_CLASSES];
+
+  static thread_local GmpArena* current_;
+};
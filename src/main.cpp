@@ -1,10 +1,43 @@
 #include <iostream>
 #include <cassert>
+#include <string>
 
 #include "matrix.h"
+#include "matrix_reader.h"
+#include "morphisms.h"
 
-int main()
+namespace {
+
+// akss_main <matrix file> [prime]: loads a sparse differential and, given a
+// prime, prints the p-local cokernel of the map it defines between free
+// groups.
+int run_file(const std::string& path, const std::size_t p)
+{
+  SparseMatrixQ f = read_sparse_matrix<mpq_class>(path);
+  std::cout << path << ": " << f.height() << "x" << f.width() << ", "
+            << f.nonzeros() << " nonzeros" << std::endl;
+
+  if (!p) return 0;
+
+  AbelianGroup Y(f.height(), 0);
+  GroupWithMorphisms C =
+      compute_cokernel(p, f, Y, MatrixQRefList(), MatrixQRefList());
+
+  std::cout << "cokernel: free rank " << C.group.free_rank() << ", torsion";
+  for (std::size_t i = 0; i < C.group.tor_rank(); ++i)
+    std::cout << " " << p << "^" << C.group(i);
+  std::cout << std::endl;
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
 {
+  if (argc > 1)
+    return run_file(argv[1], argc > 2 ? std::stoul(argv[2]) : 0);
+
   MatrixQ A(2, 3);
 
   A(0, 0) = 1;
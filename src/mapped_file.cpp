@@ -0,0 +1,38 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("MappedFile: cannot open " + path);
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("MappedFile: cannot stat " + path);
+  }
+
+  size_ = static_cast<std::size_t>(status.st_size);
+  if (size_) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("MappedFile: cannot map " + path);
+    }
+    data_ = static_cast<const char*>(data);
+    // Files are parsed front to back, so let the kernel read ahead.
+    madvise(data, size_, MADV_SEQUENTIAL);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
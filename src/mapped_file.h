@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile
+{
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  inline const char* data() const
+  {
+    return data_;
+  }
+
+  inline std::size_t size() const
+  {
+    return size_;
+  }
+
+ private:
+  const char* data_;
+  std::size_t size_;
+};
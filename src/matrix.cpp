@@ -0,0 +1,228 @@
+#include "matrix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "thread_pool.h"
+
+namespace {
+
+// Rows and columns of the product computed by one task, small enough that
+// the packed rows of both operands a tile reads stay in cache.
+const std::size_t PRODUCT_TILE = 32;
+
+std::mutex& matrix_threads_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::unique_ptr<ThreadPool>& matrix_pool()
+{
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+ThreadPool* matrix_thread_pool()
+{
+  std::lock_guard<std::mutex> lock(matrix_threads_mutex());
+
+  return matrix_pool().get();
+}
+
+std::atomic<std::size_t>& strassen_threshold_setting()
+{
+  static std::atomic<std::size_t> threshold(256);
+  return threshold;
+}
+
+// Row-major integer matrix used for the operands of the recursion.
+struct IntegerBlock {
+  IntegerBlock(const std::size_t rows, const std::size_t cols)
+      : height(rows), width(cols), entries(rows * cols)
+  {
+  }
+
+  std::size_t height;
+  std::size_t width;
+  std::vector<mpz_class> entries;
+};
+
+// The rows [i, i + height) and columns [j, j + width) of x, padded with zeros
+// where they leave x.
+IntegerBlock block(const std::vector<mpz_class>& x, const std::size_t x_height,
+                   const std::size_t x_width, const std::size_t i,
+                   const std::size_t j, const std::size_t height,
+                   const std::size_t width)
+{
+  IntegerBlock b(height, width);
+  for (std::size_t k = 0; k < height && i + k < x_height; ++k) {
+    for (std::size_t l = 0; l < width && j + l < x_width; ++l) {
+      b.entries[k * width + l] = x[(i + k) * x_width + j + l];
+    }
+  }
+  return b;
+}
+
+IntegerBlock operator+(IntegerBlock x, const IntegerBlock& y)
+{
+  for (std::size_t k = 0; k < x.entries.size(); ++k) {
+    x.entries[k] += y.entries[k];
+  }
+  return x;
+}
+
+IntegerBlock operator-(IntegerBlock x, const IntegerBlock& y)
+{
+  for (std::size_t k = 0; k < x.entries.size(); ++k) {
+    x.entries[k] -= y.entries[k];
+  }
+  return x;
+}
+
+// Classical product, with the tiles of the result spread over the pool.
+std::vector<mpz_class> tiled_product(const std::vector<mpz_class>& a,
+                                     const std::vector<mpz_class>& b_t,
+                                     const std::size_t height,
+                                     const std::size_t depth,
+                                     const std::size_t width, ThreadPool* pool)
+{
+  // The nonzero positions of every row of a, since the operands are often
+  // sparse.
+  std::vector<std::vector<std::size_t>> support(height);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t k = 0; k < depth; ++k) {
+      if (sgn(a[i * depth + k])) support[i].push_back(k);
+    }
+  }
+
+  std::vector<mpz_class> ab(height * width);
+  const std::size_t row_tiles = (height + PRODUCT_TILE - 1) / PRODUCT_TILE;
+  const std::size_t col_tiles = (width + PRODUCT_TILE - 1) / PRODUCT_TILE;
+
+  parallel_for(pool, 0, row_tiles * col_tiles, 1,
+               [&](std::size_t begin, std::size_t end) {
+                 for (std::size_t tile = begin; tile < end; ++tile) {
+                   const std::size_t i0 = tile / col_tiles * PRODUCT_TILE;
+                   const std::size_t j0 = tile % col_tiles * PRODUCT_TILE;
+                   const std::size_t i1 = std::min(i0 + PRODUCT_TILE, height);
+                   const std::size_t j1 = std::min(j0 + PRODUCT_TILE, width);
+
+                   for (std::size_t i = i0; i < i1; ++i) {
+                     const mpz_class* row = &a[i * depth];
+                     for (std::size_t j = j0; j < j1; ++j) {
+                       const mpz_class* col = &b_t[j * depth];
+                       mpz_ptr acc = ab[i * width + j].get_mpz_t();
+                       for (const std::size_t k : support[i]) {
+                         if (!sgn(col[k])) continue;
+                         mpz_addmul(acc, row[k].get_mpz_t(),
+                                    col[k].get_mpz_t());
+                       }
+                     }
+                   }
+                 }
+               });
+
+  return ab;
+}
+
+std::vector<mpz_class> product(const std::vector<mpz_class>& a,
+                               const std::vector<mpz_class>& b_t,
+                               const std::size_t height,
+                               const std::size_t depth,
+                               const std::size_t width, ThreadPool* pool,
+                               const std::size_t threshold)
+{
+  // Blocks of a single row or column would not get any smaller.
+  const std::size_t smallest = std::min(std::min(height, depth), width);
+  if (!threshold || smallest < threshold || smallest < 2)
+    return tiled_product(a, b_t, height, depth, width, pool);
+
+  const std::size_t h = (height + 1) / 2;
+  const std::size_t d = (depth + 1) / 2;
+  const std::size_t w = (width + 1) / 2;
+
+  const IntegerBlock a11 = block(a, height, depth, 0, 0, h, d);
+  const IntegerBlock a12 = block(a, height, depth, 0, d, h, d);
+  const IntegerBlock a21 = block(a, height, depth, h, 0, h, d);
+  const IntegerBlock a22 = block(a, height, depth, h, d, h, d);
+
+  // Block (x, y) of b is the transpose of block (y, x) of b_t; sums of
+  // blocks of b are taken on their transposes.
+  const IntegerBlock b11 = block(b_t, width, depth, 0, 0, w, d);
+  const IntegerBlock b12 = block(b_t, width, depth, w, 0, w, d);
+  const IntegerBlock b21 = block(b_t, width, depth, 0, d, w, d);
+  const IntegerBlock b22 = block(b_t, width, depth, w, d, w, d);
+
+  const IntegerBlock factors[7][2] = {
+      {a11 + a22, b11 + b22}, {a21 + a22, b11},       {a11, b12 - b22},
+      {a22, b21 - b11},       {a11 + a12, b22},       {a21 - a11, b11 + b12},
+      {a12 - a22, b21 + b22}};
+
+  std::vector<mpz_class> m[7];
+  parallel_for(pool, 0, 7, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; ++k) {
+      m[k] = product(factors[k][0].entries, factors[k][1].entries, h, d, w,
+                     pool, threshold);
+    }
+  });
+
+  std::vector<mpz_class> ab(height * width);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      mpz_class& x = ab[i * width + j];
+      const std::size_t k = (i % h) * w + j % w;
+      if (i < h && j < w)
+        x = m[0][k] + m[3][k] - m[4][k] + m[6][k];
+      else if (i < h)
+        x = m[2][k] + m[4][k];
+      else if (j < w)
+        x = m[1][k] + m[3][k];
+      else
+        x = m[0][k] - m[1][k] + m[2][k] + m[5][k];
+    }
+  }
+
+  return ab;
+}
+
+}  // namespace
+
+void set_matrix_threads(const std::size_t threads)
+{
+  std::lock_guard<std::mutex> lock(matrix_threads_mutex());
+
+  if (threads <= 1)
+    matrix_pool().reset();
+  else if (!matrix_pool() || matrix_pool()->size() != threads - 1)
+    matrix_pool().reset(new ThreadPool(threads - 1));
+}
+
+std::size_t matrix_threads()
+{
+  std::lock_guard<std::mutex> lock(matrix_threads_mutex());
+
+  return matrix_pool() ? matrix_pool()->size() + 1 : 1;
+}
+
+void set_strassen_threshold(const std::size_t threshold)
+{
+  strassen_threshold_setting().store(threshold);
+}
+
+std::size_t strassen_threshold()
+{
+  return strassen_threshold_setting().load();
+}
+
+std::vector<mpz_class> integer_product(const std::vector<mpz_class>& a,
+                                       const std::vector<mpz_class>& b_t,
+                                       const std::size_t height,
+                                       const std::size_t depth,
+                                       const std::size_t width)
+{
+  return product(a, b_t, height, depth, width, matrix_thread_pool(),
+                 strassen_threshold());
+}
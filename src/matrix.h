@@ -4,12 +4,63 @@
 #include <functional>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <gmpxx.h>
 
-template <typename T, template <typename> class E>
+#include "counters.h"
+
+struct RowMajor;
+struct ColMajor;
+
+template <typename T, typename L = RowMajor>
+class Matrix;
+template <typename T, typename L = RowMajor>
+class MatrixSlice;
+template <typename T>
+class MatrixRowView;
+template <typename T>
+class MatrixColumnView;
+template <typename T, typename E>
+class TransposedMatrix;
+
+// Type returned by the const entry access of the expression E: a const
+// reference for expressions backed by stored entries, a value for computed
+// ones.
+template <typename T, typename E>
+struct MatrixEntry {
+  typedef T Type;
+};
+
+template <typename T, typename L>
+struct MatrixEntry<T, Matrix<T, L>> {
+  typedef const T& Type;
+};
+
+template <typename T, typename L>
+struct MatrixEntry<T, MatrixSlice<T, L>> {
+  typedef const T& Type;
+};
+
+template <typename T>
+struct MatrixEntry<T, MatrixRowView<T>> {
+  typedef const T& Type;
+};
+
+template <typename T>
+struct MatrixEntry<T, MatrixColumnView<T>> {
+  typedef const T& Type;
+};
+
+template <typename T, typename E>
+struct MatrixEntry<T, TransposedMatrix<T, E>> {
+  typedef typename MatrixEntry<T, E>::Type Type;
+};
+
+template <typename T, typename E>
 class MatrixExpression
 {
  public:
@@ -20,37 +71,68 @@ class MatrixExpression
 
   inline std::size_t height() const
   {
-    return static_cast<const E<T>&>(*this).height();
+    return static_cast<const E&>(*this).height();
   }
 
   inline std::size_t width() const
   {
-    return static_cast<const E<T>&>(*this).width();
+    return static_cast<const E&>(*this).width();
   }
 
-  inline T operator()(const std::size_t i, const std::size_t j) const
+  inline typename MatrixEntry<T, E>::Type operator()(
+      const std::size_t i, const std::size_t j) const
   {
-    return static_cast<const E<T>&> (*this)(i, j);
+    return static_cast<const E&> (*this)(i, j);
   }
 
   inline T& operator()(const std::size_t i, const std::size_t j)
   {
-    return static_cast<E<T>&> (*this)(i, j);
+    return static_cast<E&> (*this)(i, j);
   }
 };
 
-template <typename T, template <typename> class E1,
-          template <typename> class E2>
+// Transpose of expr, which has to outlive the view.
+template <typename T, typename E>
+class TransposedMatrix : public MatrixExpression<T, TransposedMatrix<T, E>>
+{
+ public:
+  explicit TransposedMatrix(const E& expr) : expr_(expr)
+  {
+  }
+
+  inline std::size_t height() const
+  {
+    return expr_.width();
+  }
+
+  inline std::size_t width() const
+  {
+    return expr_.height();
+  }
+
+  inline typename MatrixEntry<T, E>::Type operator()(const std::size_t i,
+                                                     const std::size_t j) const
+  {
+    return expr_(j, i);
+  }
+
+ private:
+  const E& expr_;
+};
+
+template <typename T, typename E>
+TransposedMatrix<T, E> transpose(const MatrixExpression<T, E>& expr);
+
+template <typename T, typename E1, typename E2>
 bool operator==(const MatrixExpression<T, E1>& f,
                 const MatrixExpression<T, E2>& g);
 
-template <typename T, template <typename> class E1,
-          template <typename> class E2>
+template <typename T, typename E1, typename E2>
 bool operator!=(const MatrixExpression<T, E1>& f,
                 const MatrixExpression<T, E2>& g);
 
 template <typename T>
-class IdentityMatrix : public MatrixExpression<T, IdentityMatrix>
+class IdentityMatrix : public MatrixExpression<T, IdentityMatrix<T>>
 {
  public:
   IdentityMatrix(const std::size_t n);
@@ -65,25 +147,171 @@ class IdentityMatrix : public MatrixExpression<T, IdentityMatrix>
   std::size_t n_;
 };
 
+// Entries of a compact Matrix, independent of its layout. Row i has its entry
+// in column cols[i] and column j in row rows[j], unless these are the width
+// and the height of the matrix.
 template <typename T>
-class MatrixSlice;
+struct MonomialEntries {
+  std::vector<std::size_t> cols;
+  std::vector<std::size_t> rows;
+  std::vector<T> values;
+  // Referenced by all other entries.
+  T zero;
+};
+
+// Storage layouts of Matrix. Row operations are contiguous in RowMajor
+// storage and column operations in ColMajor storage.
+struct RowMajor {
+  static inline std::size_t index(const std::size_t i, const std::size_t j,
+                                  const std::size_t, const std::size_t width)
+  {
+    return i * width + j;
+  }
+};
+
+struct ColMajor {
+  static inline std::size_t index(const std::size_t i, const std::size_t j,
+                                  const std::size_t height, const std::size_t)
+  {
+    return j * height + i;
+  }
+};
+
+// The loops the row and column operations of Matrix and the matrix product
+// are built from: y += lambda * x and x *= lambda on n entries spaced by the
+// given strides. Element types that admit faster loops specialize this.
+template <typename T>
+struct EntryKernels {
+  static inline void add_mul(T* y, const std::size_t y_stride, const T* x,
+                             const std::size_t x_stride, const std::size_t n,
+                             const T& lambda)
+  {
+    for (std::size_t k = 0; k < n; ++k) {
+      y[k * y_stride] += lambda * x[k * x_stride];
+    }
+  }
+
+  static inline void mul(T* x, const std::size_t stride, const std::size_t n,
+                         const T& lambda)
+  {
+    for (std::size_t k = 0; k < n; ++k) {
+      x[k * stride] *= lambda;
+    }
+  }
+};
 
+// Row i of a matrix as a 1 x width expression, reading the entries in place.
+// The matrix must outlive the view and keep its entries.
 template <typename T>
-class Matrix : public MatrixExpression<T, Matrix>
+class MatrixRowView : public MatrixExpression<T, MatrixRowView<T>>
+{
+ public:
+  MatrixRowView(const T* data, const std::size_t stride,
+                const std::size_t size)
+      : data_(data), stride_(stride), size_(size)
+  {
+  }
+
+  inline std::size_t height() const
+  {
+    return 1;
+  }
+
+  inline std::size_t width() const
+  {
+    return size_;
+  }
+
+  inline std::size_t size() const
+  {
+    return size_;
+  }
+
+  inline const T& operator[](const std::size_t k) const
+  {
+    return data_[k * stride_];
+  }
+
+  inline const T& operator()(const std::size_t, const std::size_t j) const
+  {
+    return data_[j * stride_];
+  }
+
+ private:
+  const T* data_;
+  std::size_t stride_;
+  std::size_t size_;
+};
+
+// Column j of a matrix as a height x 1 expression, like MatrixRowView.
+template <typename T>
+class MatrixColumnView : public MatrixExpression<T, MatrixColumnView<T>>
+{
+ public:
+  MatrixColumnView(const T* data, const std::size_t stride,
+                   const std::size_t size)
+      : data_(data), stride_(stride), size_(size)
+  {
+  }
+
+  inline std::size_t height() const
+  {
+    return size_;
+  }
+
+  inline std::size_t width() const
+  {
+    return 1;
+  }
+
+  inline std::size_t size() const
+  {
+    return size_;
+  }
+
+  inline const T& operator[](const std::size_t k) const
+  {
+    return data_[k * stride_];
+  }
+
+  inline const T& operator()(const std::size_t i, const std::size_t) const
+  {
+    return data_[i * stride_];
+  }
+
+ private:
+  const T* data_;
+  std::size_t stride_;
+  std::size_t size_;
+};
+
+// Dense matrix. Copies share their entries until one of them is modified
+// (copy on write), so passing matrices around by value is cheap. References
+// returned by non-const access are not tracked: they must not be used to
+// modify the matrix after it has been copied.
+template <typename T, typename L>
+class Matrix : public MatrixExpression<T, Matrix<T, L>>
 {
  public:
   Matrix(const std::size_t height, const std::size_t width);
   Matrix(std::initializer_list<std::initializer_list<T>> lst);
 
-  Matrix(const Matrix<T>& other) = default;
-  Matrix<T>& operator=(const Matrix<T>& other);
+  Matrix(const Matrix<T, L>& other) = default;
+  Matrix<T, L>& operator=(const Matrix<T, L>& other);
 
-  Matrix(Matrix<T>&& other) = default;
-  Matrix<T>& operator=(Matrix<T>&& other) = default;
+  Matrix(Matrix<T, L>&& other) = default;
+  Matrix<T, L>& operator=(Matrix<T, L>&& other);
 
-  template <template <typename> class E>
+  // Takes over the entries of a matrix stored in another layout.
+  template <typename L2>
+  Matrix(Matrix<T, L2>&& other);
+
+  template <typename E>
   Matrix(const MatrixExpression<T, E>&& expr);
 
+  // Stored compactly, see compact().
+  Matrix(const IdentityMatrix<T>& identity);
+
   inline std::size_t height() const
   {
     return height_;
@@ -93,42 +321,89 @@ class Matrix : public MatrixExpression<T, Matrix>
     return width_;
   }
 
-  T operator()(const std::size_t i, const std::size_t j) const;
+  const T& operator()(const std::size_t i, const std::size_t j) const;
   T& operator()(const std::size_t i, const std::size_t j);
 
-  MatrixSlice<T> operator()(const std::size_t i, const std::size_t j,
-                            const std::size_t height, const std::size_t width);
+  MatrixSlice<T, L> operator()(const std::size_t i, const std::size_t j,
+                               const std::size_t height,
+                               const std::size_t width);
+
+  MatrixRowView<T> row(const std::size_t i) const;
+  MatrixColumnView<T> col(const std::size_t j) const;
+
+  // Clones the entries if they are shared with another matrix. Non-const
+  // access does this implicitly; it has to be done explicitly before several
+  // threads modify the matrix at once.
+  void detach();
+
+  // Whether the entries are stored compactly, which identities are until the
+  // first row or column addition. Compact matrices have at most one nonzero
+  // entry in every row and column; swaps, multiplications and const access
+  // keep them compact, any other non-const access stores them densely.
+  inline bool compact() const
+  {
+    return monomial_ != nullptr;
+  }
+
+  // Stores the entries densely, as row() and col() require.
+  void expand();
 
   static IdentityMatrix<T> identity(const std::size_t n);
 
-  Matrix<T>& row_add(const std::size_t i1, const std::size_t i2,
-                     const T& lambda);
-  Matrix<T>& row_mul(const std::size_t i, const T& lambda);
-  Matrix<T>& row_swap(const std::size_t i1, const std::size_t i2);
+  Matrix<T, L>& row_add(const std::size_t i1, const std::size_t i2,
+                        const T& lambda);
+  Matrix<T, L>& row_mul(const std::size_t i, const T& lambda);
+  Matrix<T, L>& row_swap(const std::size_t i1, const std::size_t i2);
 
-  Matrix<T>& col_add(const std::size_t j1, const std::size_t j2,
-                     const T& lambda);
-  Matrix<T>& col_mul(const std::size_t j, const T& lambda);
-  Matrix<T>& col_swap(const std::size_t j1, const std::size_t j2);
+  Matrix<T, L>& col_add(const std::size_t j1, const std::size_t j2,
+                        const T& lambda);
+  Matrix<T, L>& col_mul(const std::size_t j, const T& lambda);
+  Matrix<T, L>& col_swap(const std::size_t j1, const std::size_t j2);
 
  private:
+  template <typename, typename>
+  friend class Matrix;
+
+  template <typename U, typename L1, typename L2>
+  friend Matrix<U, L1> operator*(const Matrix<U, L1>& g,
+                                 const Matrix<U, L2>& f);
+  template <typename U, typename L1, typename L2>
+  friend Matrix<U, L1> compact_product(const Matrix<U, L1>& g,
+                                       const Matrix<U, L2>& f);
+
+  typedef MonomialEntries<T> Monomial;
+
+  // Compact zero matrix.
+  Matrix(const std::size_t height, const std::size_t width,
+         std::shared_ptr<Monomial> monomial);
+
+  Monomial& monomial();
+
+  inline std::size_t index(const std::size_t i, const std::size_t j) const
+  {
+    return L::index(i, j, height_, width_);
+  }
+
+  std::vector<T>& entries();
+
   const std::size_t height_;
   const std::size_t width_;
-  std::vector<T> entries_;
+  std::shared_ptr<std::vector<T>> entries_;
+  std::shared_ptr<Monomial> monomial_;
 };
 
-template <typename T>
-class MatrixSlice : public MatrixExpression<T, MatrixSlice>
+template <typename T, typename L>
+class MatrixSlice : public MatrixExpression<T, MatrixSlice<T, L>>
 {
  public:
-  MatrixSlice(Matrix<T>& mat, const std::size_t i, const std::size_t j,
+  MatrixSlice(Matrix<T, L>& mat, const std::size_t i, const std::size_t j,
               const std::size_t height, const std::size_t width);
-  MatrixSlice(MatrixSlice<T>&& other) = default;
+  MatrixSlice(MatrixSlice<T, L>&& other) = default;
 
-  MatrixSlice<T>& operator=(const MatrixSlice<T>& other);
+  MatrixSlice<T, L>& operator=(const MatrixSlice<T, L>& other);
 
-  template <template <typename> class E>
-  MatrixSlice<T>& operator=(const MatrixExpression<T, E>& expr);
+  template <typename E>
+  MatrixSlice<T, L>& operator=(const MatrixExpression<T, E>& expr);
 
   inline std::size_t height() const
   {
@@ -140,42 +415,84 @@ class MatrixSlice : public MatrixExpression<T, MatrixSlice>
     return width_;
   }
 
-  T operator()(const std::size_t i, const std::size_t j) const;
+  const T& operator()(const std::size_t i, const std::size_t j) const;
   T& operator()(const std::size_t i, const std::size_t j);
 
  private:
-  Matrix<T>& mat_;
+  Matrix<T, L>& mat_;
   const std::size_t i_;
   const std::size_t j_;
   const std::size_t height_;
   const std::size_t width_;
 };
 
-template <typename T>
-using MatrixList = std::vector<Matrix<T>>;
-template <typename T>
-using MatrixRef = std::reference_wrapper<Matrix<T>>;
-template <typename T>
-using MatrixRefList = std::vector<MatrixRef<T>>;
-
-template <typename T>
-void basis_vectors_add(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                       const std::size_t i1, const std::size_t i2,
+template <typename T, typename L = RowMajor>
+using MatrixList = std::vector<Matrix<T, L>>;
+template <typename T, typename L = RowMajor>
+using MatrixRef = std::reference_wrapper<Matrix<T, L>>;
+template <typename T, typename L = RowMajor>
+using MatrixRefList = std::vector<MatrixRef<T, L>>;
+
+// Basis changes only apply row operations to to_X and column operations to
+// from_X, so from_X is best stored in ColMajor layout.
+template <typename T, typename LT, typename LF>
+void basis_vectors_add(MatrixRefList<T, LT>& to_X,
+                       MatrixRefList<T, LF>& from_X, const std::size_t i1,
+                       const std::size_t i2, const T& lambda);
+template <typename T, typename LT, typename LF>
+void basis_vectors_mul(MatrixRefList<T, LT>& to_X,
+                       MatrixRefList<T, LF>& from_X, const std::size_t i,
                        const T& lambda);
-template <typename T>
-void basis_vectors_mul(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                       const std::size_t i, const T& lambda);
-template <typename T>
-void basis_vectors_swap(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                        const std::size_t i1, const std::size_t i2);
+template <typename T, typename LT, typename LF>
+void basis_vectors_swap(MatrixRefList<T, LT>& to_X,
+                        MatrixRefList<T, LF>& from_X, const std::size_t i1,
+                        const std::size_t i2);
 
 using MatrixQ = Matrix<mpq_class>;
 using MatrixQList = MatrixList<mpq_class>;
 using MatrixQRefList = MatrixRefList<mpq_class>;
 
-template <typename T>
-MatrixList<T> deref(const MatrixRefList<T>& ref_list);
-template <typename T>
-MatrixRefList<T> ref(MatrixList<T>& list);
+template <typename T, typename L>
+MatrixList<T, L> deref(const MatrixRefList<T, L>& ref_list);
+// Copies into layout L2, as in deref<ColMajor>(ref_list).
+template <typename L2, typename T, typename L>
+MatrixList<T, L2> deref(const MatrixRefList<T, L>& ref_list);
+template <typename T, typename L>
+MatrixRefList<T, L> ref(MatrixList<T, L>& list);
+
+// Product of matrices at least one of which is compact, in time linear in
+// the size of the result. Both products use it for such factors; the result
+// is compact if both factors are.
+template <typename T, typename L1, typename L2>
+Matrix<T, L1> compact_product(const Matrix<T, L1>& g, const Matrix<T, L2>& f);
+
+// Products of rational matrices are computed over integers: g is scaled by a
+// common denominator per row and f by one per column, so that every entry of
+// the product is a dot product accumulated with mpz_addmul. f is packed
+// transposed for that. Tiles of the result are computed on the threads set by
+// set_matrix_threads, and products whose dimensions are all at least the
+// Strassen threshold are split recursively by Strassen's algorithm. Neither
+// setting changes the result. They must not be changed while a product is
+// running.
+template <typename L1, typename L2>
+Matrix<mpq_class, L1> operator*(const Matrix<mpq_class, L1>& g,
+                                const Matrix<mpq_class, L2>& f);
+
+// Including the calling thread. set_smith_threads sets this as well.
+void set_matrix_threads(const std::size_t threads);
+std::size_t matrix_threads();
+
+// 0 disables Strassen's algorithm.
+void set_strassen_threshold(const std::size_t threshold);
+std::size_t strassen_threshold();
+
+// Integer product behind the rational one: returns the row-major height x
+// width matrix a * b, where a is height x depth and b_t is the width x depth
+// transpose of b, both row-major.
+std::vector<mpz_class> integer_product(const std::vector<mpz_class>& a,
+                                       const std::vector<mpz_class>& b_t,
+                                       const std::size_t height,
+                                       const std::size_t depth,
+                                       const std::size_t width);
 
 #include "matrix_impl.h"
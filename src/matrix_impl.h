@@ -1,10 +1,9 @@
-template <typename T, template <typename> class E>
+template <typename T, typename E>
 MatrixExpression<T, E>::MatrixExpression(const MatrixExpression<T, E>&)
 {
 }
 
-template <typename T, template <typename> class E1,
-          template <typename> class E2>
+template <typename T, typename E1, typename E2>
 bool operator==(const MatrixExpression<T, E1>& f,
                 const MatrixExpression<T, E2>& g)
 {
@@ -21,14 +20,19 @@ bool operator==(const MatrixExpression<T, E1>& f,
   return true;
 }
 
-template <typename T, template <typename> class E1,
-          template <typename> class E2>
+template <typename T, typename E1, typename E2>
 bool operator!=(const MatrixExpression<T, E1>& f,
                 const MatrixExpression<T, E2>& g)
 {
   return !(f == g);
 }
 
+template <typename T, typename E>
+TransposedMatrix<T, E> transpose(const MatrixExpression<T, E>& expr)
+{
+  return TransposedMatrix<T, E>(static_cast<const E&>(expr));
+}
+
 template <typename T>
 IdentityMatrix<T>::IdentityMatrix(const std::size_t n)
     : n_(n)
@@ -53,135 +57,346 @@ T IdentityMatrix<T>::operator()(const std::size_t i, const std::size_t j) const
   return i == j ? 1 : 0;
 }
 
-template <typename T>
-Matrix<T>::Matrix(const std::size_t height, const std::size_t width)
-    : height_(height), width_(width), entries_(height_ * width_)
+template <typename T, typename L>
+Matrix<T, L>::Matrix(const std::size_t height, const std::size_t width)
+    : height_(height),
+      width_(width),
+      entries_(std::make_shared<std::vector<T>>(height_ * width_))
 {
 }
 
-template <typename T>
-Matrix<T>::Matrix(std::initializer_list<std::initializer_list<T>> lst)
-    : height_(lst.size()), width_(height_ ? lst.begin()->size() : 0)
+template <typename T, typename L>
+Matrix<T, L>::Matrix(std::initializer_list<std::initializer_list<T>> lst)
+    : height_(lst.size()),
+      width_(height_ ? lst.begin()->size() : 0),
+      entries_(std::make_shared<std::vector<T>>(height_ * width_))
 {
-  entries_.reserve(height_ * width_);
-
+  std::size_t i = 0;
   for (const auto& row : lst) {
+    std::size_t j = 0;
     for (const T& value : row) {
-      entries_.push_back(value);
+      (*entries_)[index(i, j++)] = value;
     }
+    ++i;
   }
 }
 
-template <typename T>
-template <template <typename> class E>
-Matrix<T>::Matrix(const MatrixExpression<T, E>&& expr)
-    : height_(expr.height()), width_(expr.width())
+template <typename T, typename L>
+template <typename L2>
+Matrix<T, L>::Matrix(Matrix<T, L2>&& other)
+    : height_(other.height_),
+      width_(other.width_),
+      monomial_(std::move(other.monomial_))
 {
-  entries_.reserve(height_ * width_);
+  using std::swap;
+
+  // Compact entries do not depend on the layout.
+  if (monomial_) return;
+  entries_ = std::make_shared<std::vector<T>>(height_ * width_);
+
+  // Entries shared with another matrix have to stay where they are.
+  const bool shared = other.entries_.use_count() > 1;
+  std::vector<T>& entries = *entries_;
+  std::vector<T>& other_entries = *other.entries_;
 
   for (std::size_t i = 0; i < height_; ++i) {
     for (std::size_t j = 0; j < width_; ++j) {
-      entries_.push_back(expr(i, j));
+      if (shared)
+        entries[index(i, j)] = other_entries[other.index(i, j)];
+      else
+        swap(entries[index(i, j)], other_entries[other.index(i, j)]);
     }
   }
 }
 
-template <typename T>
-T Matrix<T>::operator()(const std::size_t i, const std::size_t j) const
+template <typename T, typename L>
+template <typename E>
+Matrix<T, L>::Matrix(const MatrixExpression<T, E>&& expr)
+    : height_(expr.height()),
+      width_(expr.width()),
+      entries_(std::make_shared<std::vector<T>>())
 {
-  return entries_[i * width_ + j];
+  std::vector<T>& entries = *entries_;
+  entries.reserve(height_ * width_);
+
+  // Entries are appended in storage order.
+  if (std::is_same<L, RowMajor>::value) {
+    for (std::size_t i = 0; i < height_; ++i) {
+      for (std::size_t j = 0; j < width_; ++j) {
+        entries.push_back(expr(i, j));
+      }
+    }
+  } else {
+    for (std::size_t j = 0; j < width_; ++j) {
+      for (std::size_t i = 0; i < height_; ++i) {
+        entries.push_back(expr(i, j));
+      }
+    }
+  }
 }
 
-template <typename T>
-T& Matrix<T>::operator()(const std::size_t i, const std::size_t j)
+template <typename T, typename L>
+Matrix<T, L>::Matrix(const IdentityMatrix<T>& identity)
+    : Matrix(identity.height(), identity.width(), std::make_shared<Monomial>())
+{
+  Monomial& monomial = *monomial_;
+  for (std::size_t i = 0; i < height_; ++i) {
+    monomial.cols[i] = i;
+    monomial.rows[i] = i;
+    monomial.values[i] = 1;
+  }
+}
+
+template <typename T, typename L>
+Matrix<T, L>::Matrix(const std::size_t height, const std::size_t width,
+                     std::shared_ptr<Monomial> monomial)
+    : height_(height), width_(width), monomial_(std::move(monomial))
 {
-  return entries_[i * width_ + j];
+  monomial_->cols.assign(height_, width_);
+  monomial_->rows.assign(width_, height_);
+  monomial_->values.resize(height_);
 }
 
-template <typename T>
-MatrixSlice<T> Matrix<T>::operator()(const std::size_t i, const std::size_t j,
-                                     const std::size_t height,
-                                     const std::size_t width)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::operator=(const Matrix<T, L>& other)
 {
-  return MatrixSlice<T>(*this, i, j, height, width);
+  if (height_ != other.height_ || width_ != other.width_)
+    throw std::logic_error("Matrix::operator=: Dimension mismatch: " +
+                           std::to_string(height_) + "x" +
+                           std::to_string(width_) + " != " +
+                           std::to_string(other.height_) + "x" +
+                           std::to_string(other.width_));
+
+  entries_ = other.entries_;
+  monomial_ = other.monomial_;
+  return *this;
 }
 
-template <typename T>
-IdentityMatrix<T> Matrix<T>::identity(const std::size_t n)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::operator=(Matrix<T, L>&& other)
 {
-  return IdentityMatrix<T>(n);
+  if (height_ != other.height_ || width_ != other.width_)
+    throw std::logic_error("Matrix::operator=: Dimension mismatch: " +
+                           std::to_string(height_) + "x" +
+                           std::to_string(width_) + " != " +
+                           std::to_string(other.height_) + "x" +
+                           std::to_string(other.width_));
+
+  entries_ = std::move(other.entries_);
+  monomial_ = std::move(other.monomial_);
+  return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::row_add(const std::size_t i1, const std::size_t i2,
-                              const T& lambda)
+template <typename T, typename L>
+const T& Matrix<T, L>::operator()(const std::size_t i,
+                                  const std::size_t j) const
 {
-  for (std::size_t j = 0; j < width_; ++j) {
-    entries_[i2 * width_ + j] += lambda * entries_[i1 * width_ + j];
+  if (entries_) return (*entries_)[index(i, j)];
+
+  const Monomial& monomial = *monomial_;
+  return monomial.cols[i] == j ? monomial.values[i] : monomial.zero;
+}
+
+template <typename T, typename L>
+T& Matrix<T, L>::operator()(const std::size_t i, const std::size_t j)
+{
+  return entries()[index(i, j)];
+}
+
+template <typename T, typename L>
+MatrixSlice<T, L> Matrix<T, L>::operator()(const std::size_t i,
+                                           const std::size_t j,
+                                           const std::size_t height,
+                                           const std::size_t width)
+{
+  return MatrixSlice<T, L>(*this, i, j, height, width);
+}
+
+template <typename T, typename L>
+MatrixRowView<T> Matrix<T, L>::row(const std::size_t i) const
+{
+  if (monomial_)
+    throw std::logic_error("Matrix::row: Entries are stored compactly");
+
+  return MatrixRowView<T>(entries_->data() + index(i, 0),
+                          L::index(0, 1, height_, width_), width_);
+}
+
+template <typename T, typename L>
+MatrixColumnView<T> Matrix<T, L>::col(const std::size_t j) const
+{
+  if (monomial_)
+    throw std::logic_error("Matrix::col: Entries are stored compactly");
+
+  return MatrixColumnView<T>(entries_->data() + index(0, j),
+                             L::index(1, 0, height_, width_), height_);
+}
+
+template <typename T, typename L>
+void Matrix<T, L>::detach()
+{
+  if (monomial_ && monomial_.use_count() > 1)
+    monomial_ = std::make_shared<Monomial>(*monomial_);
+  if (entries_ && entries_.use_count() > 1)
+    entries_ = std::make_shared<std::vector<T>>(*entries_);
+}
+
+template <typename T, typename L>
+void Matrix<T, L>::expand()
+{
+  if (!monomial_) return;
+
+  entries_ = std::make_shared<std::vector<T>>(height_ * width_);
+  const Monomial& monomial = *monomial_;
+  for (std::size_t i = 0; i < height_; ++i) {
+    if (monomial.cols[i] != width_)
+      (*entries_)[index(i, monomial.cols[i])] = monomial.values[i];
+  }
+  monomial_.reset();
+}
+
+template <typename T, typename L>
+std::vector<T>& Matrix<T, L>::entries()
+{
+  // Compact matrices have no dense entries, so unshared dense entries are
+  // recognized by a single check.
+  if (entries_.use_count() != 1) {
+    expand();
+    detach();
   }
+
+  return *entries_;
+}
+
+template <typename T, typename L>
+typename Matrix<T, L>::Monomial& Matrix<T, L>::monomial()
+{
+  detach();
+  return *monomial_;
+}
+
+template <typename T, typename L>
+IdentityMatrix<T> Matrix<T, L>::identity(const std::size_t n)
+{
+  return IdentityMatrix<T>(n);
+}
+
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::row_add(const std::size_t i1, const std::size_t i2,
+                                    const T& lambda)
+{
+  AKSS_COUNT(RowAdd);
+  if (monomial_ && (monomial_->cols[i1] == width_ || !lambda)) return *this;
+  std::vector<T>& entries = this->entries();
+
+  const std::size_t stride = L::index(0, 1, height_, width_);
+  EntryKernels<T>::add_mul(entries.data() + index(i2, 0), stride,
+                           entries.data() + index(i1, 0), stride, width_,
+                           lambda);
   return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::row_mul(const std::size_t i, const T& lambda)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::row_mul(const std::size_t i, const T& lambda)
 {
-  for (std::size_t j = 0; j < width_; ++j) {
-    entries_[i * width_ + j] *= lambda;
+  AKSS_COUNT(RowMul);
+  if (monomial_) {
+    Monomial& monomial = this->monomial();
+    if (monomial.cols[i] != width_) monomial.values[i] *= lambda;
+    return *this;
   }
+  std::vector<T>& entries = this->entries();
+
+  EntryKernels<T>::mul(entries.data() + index(i, 0),
+                       L::index(0, 1, height_, width_), width_, lambda);
   return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::row_swap(const std::size_t i1, const std::size_t i2)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::row_swap(const std::size_t i1, const std::size_t i2)
 {
+  AKSS_COUNT(RowSwap);
   using std::swap;
 
+  if (monomial_) {
+    Monomial& monomial = this->monomial();
+    swap(monomial.cols[i1], monomial.cols[i2]);
+    swap(monomial.values[i1], monomial.values[i2]);
+    if (monomial.cols[i1] != width_) monomial.rows[monomial.cols[i1]] = i1;
+    if (monomial.cols[i2] != width_) monomial.rows[monomial.cols[i2]] = i2;
+    return *this;
+  }
+  std::vector<T>& entries = this->entries();
+
   for (std::size_t j = 0; j < width_; ++j) {
-    swap(entries_[i1 * width_ + j], entries_[i2 * width_ + j]);
+    swap(entries[index(i1, j)], entries[index(i2, j)]);
   }
   return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::col_add(const std::size_t j1, const std::size_t j2,
-                              const T& lambda)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::col_add(const std::size_t j1, const std::size_t j2,
+                                    const T& lambda)
 {
-  for (std::size_t i = 0; i < height_; ++i) {
-    entries_[i * width_ + j2] += lambda * entries_[i * width_ + j1];
-  }
+  AKSS_COUNT(ColAdd);
+  if (monomial_ && (monomial_->rows[j1] == height_ || !lambda)) return *this;
+  std::vector<T>& entries = this->entries();
+
+  const std::size_t stride = L::index(1, 0, height_, width_);
+  EntryKernels<T>::add_mul(entries.data() + index(0, j2), stride,
+                           entries.data() + index(0, j1), stride, height_,
+                           lambda);
   return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::col_mul(const std::size_t j, const T& lambda)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::col_mul(const std::size_t j, const T& lambda)
 {
-  for (std::size_t i = 0; i < height_; ++i) {
-    entries_[i * width_ + j] *= lambda;
+  AKSS_COUNT(ColMul);
+  if (monomial_) {
+    Monomial& monomial = this->monomial();
+    const std::size_t i = monomial.rows[j];
+    if (i != height_) monomial.values[i] *= lambda;
+    return *this;
   }
+  std::vector<T>& entries = this->entries();
+
+  EntryKernels<T>::mul(entries.data() + index(0, j),
+                       L::index(1, 0, height_, width_), height_, lambda);
   return *this;
 }
 
-template <typename T>
-Matrix<T>& Matrix<T>::col_swap(const std::size_t j1, const std::size_t j2)
+template <typename T, typename L>
+Matrix<T, L>& Matrix<T, L>::col_swap(const std::size_t j1, const std::size_t j2)
 {
+  AKSS_COUNT(ColSwap);
   using std::swap;
 
+  if (monomial_) {
+    Monomial& monomial = this->monomial();
+    swap(monomial.rows[j1], monomial.rows[j2]);
+    if (monomial.rows[j1] != height_) monomial.cols[monomial.rows[j1]] = j1;
+    if (monomial.rows[j2] != height_) monomial.cols[monomial.rows[j2]] = j2;
+    return *this;
+  }
+  std::vector<T>& entries = this->entries();
+
   for (std::size_t i = 0; i < height_; ++i) {
-    swap(entries_[i * width_ + j1], entries_[i * width_ + j2]);
+    swap(entries[index(i, j1)], entries[index(i, j2)]);
   }
   return *this;
 }
 
-template <typename T>
-MatrixSlice<T>::MatrixSlice(Matrix<T>& mat, const std::size_t i,
-                            const std::size_t j, const std::size_t height,
-                            const std::size_t width)
+template <typename T, typename L>
+MatrixSlice<T, L>::MatrixSlice(Matrix<T, L>& mat, const std::size_t i,
+                               const std::size_t j, const std::size_t height,
+                               const std::size_t width)
     : mat_(mat), i_(i), j_(j), height_(height), width_(width)
 {
 }
 
-template <typename T>
-MatrixSlice<T>& MatrixSlice<T>::operator=(const MatrixSlice<T>& other)
+template <typename T, typename L>
+MatrixSlice<T, L>& MatrixSlice<T, L>::operator=(const MatrixSlice<T, L>& other)
 {
   if (&mat_ == &other.mat_) {
     if (i_ < other.i_ + other.height_ && i_ + height_ > other.i_ &&
@@ -189,13 +404,14 @@ MatrixSlice<T>& MatrixSlice<T>::operator=(const MatrixSlice<T>& other)
       throw std::logic_error("MatrixSlice::operator=: Matrix slices overlap");
   }
 
-  return (*this =
-              static_cast<const MatrixExpression<T, ::MatrixSlice>&>(other));
+  return (*this = static_cast<const MatrixExpression<T, MatrixSlice<T, L>>&>(
+              other));
 }
 
-template <typename T>
-template <template <typename> class E>
-MatrixSlice<T>& MatrixSlice<T>::operator=(const MatrixExpression<T, E>& expr)
+template <typename T, typename L>
+template <typename E>
+MatrixSlice<T, L>& MatrixSlice<T, L>::operator=(
+    const MatrixExpression<T, E>& expr)
 {
   if (height() != expr.height())
     throw std::logic_error("MatrixSlice::operator=: Dimension mismatch: " +
@@ -215,44 +431,189 @@ MatrixSlice<T>& MatrixSlice<T>::operator=(const MatrixExpression<T, E>& expr)
   return *this;
 }
 
-template <typename T>
-T MatrixSlice<T>::operator()(const std::size_t i, const std::size_t j) const
+template <typename T, typename L>
+const T& MatrixSlice<T, L>::operator()(const std::size_t i,
+                                       const std::size_t j) const
 {
-  return mat_(i_ + i, j_ + j);
+  // Reading must neither unshare nor expand the matrix.
+  return static_cast<const Matrix<T, L>&>(mat_)(i_ + i, j_ + j);
 }
 
-template <typename T>
-T& MatrixSlice<T>::operator()(const std::size_t i, const std::size_t j)
+template <typename T, typename L>
+T& MatrixSlice<T, L>::operator()(const std::size_t i, const std::size_t j)
 {
   return mat_(i_ + i, j_ + j);
 }
 
-template <typename T>
-Matrix<T> operator*(const Matrix<T>& g, const Matrix<T>& f)
+template <typename T, typename L1, typename L2>
+Matrix<T, L1> operator*(const Matrix<T, L1>& g, const Matrix<T, L2>& f)
 {
   if (g.width() != f.height())
     throw std::logic_error("Matrix<T>::operator*: Dimension mismatch" +
                            std::to_string(g.width()) + " != " +
                            std::to_string(f.height()));
 
-  Matrix<T> gf(g.height(), f.width());
+  if (g.compact() || f.compact()) return compact_product(g, f);
+
+  // Row i of gf is accumulated as the combination of the rows of f with the
+  // coefficients in row i of g, which skips zero coefficients and runs over
+  // contiguous entries for row-major matrices.
+  Matrix<T, L1> gf(g.height(), f.width());
+  T* gf_entries = gf.entries_->data();
+  const T* f_entries = f.entries_->data();
+  const std::size_t gf_stride = L1::index(0, 1, gf.height_, gf.width_);
+  const std::size_t f_stride = L2::index(0, 1, f.height_, f.width_);
+
   for (std::size_t i = 0; i < g.height(); ++i) {
-    for (std::size_t j = 0; j < f.width(); ++j) {
-      T acc;
+    for (std::size_t k = 0; k < g.width(); ++k) {
+      const T& lambda = g(i, k);
+      if (!lambda) continue;
 
-      for (std::size_t k = 0; k < g.width(); ++k) {
-        acc += g(i, k) * f(k, j);
-      }
+      EntryKernels<T>::add_mul(gf_entries + gf.index(i, 0), gf_stride,
+                               f_entries + f.index(k, 0), f_stride,
+                               f.width(), lambda);
+    }
+  }
+
+  return gf;
+}
+
+template <typename L1, typename L2>
+Matrix<mpq_class, L1> operator*(const Matrix<mpq_class, L1>& g,
+                                const Matrix<mpq_class, L2>& f)
+{
+  if (g.width() != f.height())
+    throw std::logic_error("Matrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(g.width()) + " != " +
+                           std::to_string(f.height()));
 
-      gf(i, j) = acc;
+  if (g.compact() || f.compact()) return compact_product(g, f);
+
+  const std::size_t height = g.height();
+  const std::size_t depth = g.width();
+  const std::size_t width = f.width();
+
+  // a(i, k) = g(i, k) * g_dens[i] and b_t(j, k) = f(k, j) * f_dens[j].
+  std::vector<mpz_class> g_dens(height, 1);
+  std::vector<mpz_class> a(height * depth);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t k = 0; k < depth; ++k) {
+      const mpz_class& den = g(i, k).get_den();
+      if (den != 1) mpz_lcm(g_dens[i].get_mpz_t(), g_dens[i].get_mpz_t(),
+                            den.get_mpz_t());
+    }
+    for (std::size_t k = 0; k < depth; ++k) {
+      const mpq_class& x = g(i, k);
+      if (!x) continue;
+      mpz_divexact(a[i * depth + k].get_mpz_t(), g_dens[i].get_mpz_t(),
+                   x.get_den_mpz_t());
+      a[i * depth + k] *= x.get_num();
+    }
+  }
+
+  std::vector<mpz_class> f_dens(width, 1);
+  std::vector<mpz_class> b_t(width * depth);
+  for (std::size_t j = 0; j < width; ++j) {
+    for (std::size_t k = 0; k < depth; ++k) {
+      const mpz_class& den = f(k, j).get_den();
+      if (den != 1) mpz_lcm(f_dens[j].get_mpz_t(), f_dens[j].get_mpz_t(),
+                            den.get_mpz_t());
+    }
+    for (std::size_t k = 0; k < depth; ++k) {
+      const mpq_class& x = f(k, j);
+      if (!x) continue;
+      mpz_divexact(b_t[j * depth + k].get_mpz_t(), f_dens[j].get_mpz_t(),
+                   x.get_den_mpz_t());
+      b_t[j * depth + k] *= x.get_num();
+    }
+  }
+
+  std::vector<mpz_class> ab = integer_product(a, b_t, height, depth, width);
+
+  Matrix<mpq_class, L1> gf(height, width);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      mpq_class& x = gf(i, j);
+      mpz_swap(x.get_num_mpz_t(), ab[i * width + j].get_mpz_t());
+      if (g_dens[i] == 1 && f_dens[j] == 1) continue;
+
+      mpz_mul(x.get_den_mpz_t(), g_dens[i].get_mpz_t(), f_dens[j].get_mpz_t());
+      x.canonicalize();
     }
   }
 
   return gf;
 }
 
-template <typename T>
-std::ostream& operator<<(std::ostream& stream, const Matrix<T>& f)
+template <typename T, typename L1, typename L2>
+Matrix<T, L1> compact_product(const Matrix<T, L1>& g, const Matrix<T, L2>& f)
+{
+  if (g.width() != f.height())
+    throw std::logic_error("compact_product: Dimension mismatch" +
+                           std::to_string(g.width()) + " != " +
+                           std::to_string(f.height()));
+
+  typedef MonomialEntries<T> Monomial;
+
+  if (g.compact() && f.compact()) {
+    const Monomial& g_entries = *g.monomial_;
+    const Monomial& f_entries = *f.monomial_;
+
+    // Row i of gf has its entry where row g.cols[i] of f has it.
+    Matrix<T, L1> gf(g.height(), f.width(), std::make_shared<Monomial>());
+    Monomial& gf_entries = *gf.monomial_;
+    for (std::size_t i = 0; i < g.height(); ++i) {
+      const std::size_t k = g_entries.cols[i];
+      if (k == g.width() || f_entries.cols[k] == f.width()) continue;
+
+      gf_entries.cols[i] = f_entries.cols[k];
+      gf_entries.rows[f_entries.cols[k]] = i;
+      gf_entries.values[i] = g_entries.values[i] * f_entries.values[k];
+    }
+    return gf;
+  }
+
+  // The dense factor is only copied, and scaled where the monomial entry is
+  // not 1.
+  Matrix<T, L1> gf(g.height(), f.width());
+  T* gf_entries = gf.entries_->data();
+  if (g.compact()) {
+    // Row i of gf is a multiple of row g.cols[i] of f.
+    const Monomial& g_entries = *g.monomial_;
+    const T* f_entries = f.entries_->data();
+    for (std::size_t i = 0; i < g.height(); ++i) {
+      const std::size_t k = g_entries.cols[i];
+      if (k == g.width()) continue;
+
+      const T& lambda = g_entries.values[i];
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        T& x = gf_entries[gf.index(i, j)];
+        x = f_entries[f.index(k, j)];
+        if (lambda != 1) x *= lambda;
+      }
+    }
+  } else {
+    // Column j of gf is a multiple of column f.rows[j] of g.
+    const Monomial& f_entries = *f.monomial_;
+    const T* g_entries = g.entries_->data();
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      const std::size_t k = f_entries.rows[j];
+      if (k == f.height()) continue;
+
+      const T& lambda = f_entries.values[k];
+      for (std::size_t i = 0; i < g.height(); ++i) {
+        T& x = gf_entries[gf.index(i, j)];
+        x = g_entries[g.index(i, k)];
+        if (lambda != 1) x *= lambda;
+      }
+    }
+  }
+
+  return gf;
+}
+
+template <typename T, typename L>
+std::ostream& operator<<(std::ostream& stream, const Matrix<T, L>& f)
 {
   stream << "Matrix (" << f.height() << "x" << f.width() << ")\n";
 
@@ -267,66 +628,81 @@ std::ostream& operator<<(std::ostream& stream, const Matrix<T>& f)
   return stream;
 }
 
-template <typename T>
-void basis_vectors_add(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                       const std::size_t i1, const std::size_t i2,
-                       const T& lambda)
+template <typename T, typename LT, typename LF>
+void basis_vectors_add(MatrixRefList<T, LT>& to_X,
+                       MatrixRefList<T, LF>& from_X, const std::size_t i1,
+                       const std::size_t i2, const T& lambda)
 {
-  for (Matrix<T>& f : to_X) {
+  for (Matrix<T, LT>& f : to_X) {
     f.row_add(i2, i1, -lambda);
   }
 
-  for (Matrix<T>& f : from_X) {
+  for (Matrix<T, LF>& f : from_X) {
     f.col_add(i1, i2, lambda);
   }
 }
 
-template <typename T>
-void basis_vectors_mul(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                       const std::size_t i, const T& lambda)
+template <typename T, typename LT, typename LF>
+void basis_vectors_mul(MatrixRefList<T, LT>& to_X,
+                       MatrixRefList<T, LF>& from_X, const std::size_t i,
+                       const T& lambda)
 {
-  for (Matrix<T>& f : to_X) {
+  for (Matrix<T, LT>& f : to_X) {
     f.row_mul(i, 1 / lambda);
   }
 
-  for (Matrix<T>& f : from_X) {
+  for (Matrix<T, LF>& f : from_X) {
     f.col_mul(i, lambda);
   }
 }
 
-template <typename T>
-void basis_vectors_swap(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
-                        const std::size_t i1, const std::size_t i2)
+template <typename T, typename LT, typename LF>
+void basis_vectors_swap(MatrixRefList<T, LT>& to_X,
+                        MatrixRefList<T, LF>& from_X, const std::size_t i1,
+                        const std::size_t i2)
 {
-  for (Matrix<T>& f : to_X) {
+  for (Matrix<T, LT>& f : to_X) {
     f.row_swap(i2, i1);
   }
 
-  for (Matrix<T>& f : from_X) {
+  for (Matrix<T, LF>& f : from_X) {
     f.col_swap(i1, i2);
   }
 }
 
-template <typename T>
-MatrixList<T> deref(const MatrixRefList<T>& ref_list)
+template <typename T, typename L>
+MatrixList<T, L> deref(const MatrixRefList<T, L>& ref_list)
 {
-  MatrixList<T> list;
+  MatrixList<T, L> list;
   list.reserve(ref_list.size());
 
-  for (Matrix<T> mat : ref_list) {
+  for (Matrix<T, L> mat : ref_list) {
     list.push_back(mat);
   }
 
   return list;
 }
 
-template <typename T>
-MatrixRefList<T> ref(MatrixList<T>& list)
+template <typename L2, typename T, typename L>
+MatrixList<T, L2> deref(const MatrixRefList<T, L>& ref_list)
+{
+  MatrixList<T, L2> list;
+  list.reserve(ref_list.size());
+
+  for (Matrix<T, L> mat : ref_list) {
+    list.emplace_back(std::move(mat));
+  }
+
+  return list;
+}
+
+template <typename T, typename L>
+MatrixRefList<T, L> ref(MatrixList<T, L>& list)
 {
-  MatrixRefList<T> ref_list;
+  MatrixRefList<T, L> ref_list;
   ref_list.reserve(list.size());
 
-  for (Matrix<T>& mat : list) {
+  for (Matrix<T, L>& mat : list) {
     ref_list.emplace_back(mat);
   }
 
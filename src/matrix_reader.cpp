@@ -0,0 +1,211 @@
+#include "matrix_reader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+inline bool is_space(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool is_digit(const char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+std::string lower(std::string word)
+{
+  for (char& c : word) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return word;
+}
+
+// Decimal digits that always fit into an int64_t.
+const std::size_t WORD_DIGITS = 18;
+
+}  // namespace
+
+TripletReader::TripletReader(const std::string& path)
+    : file_(path),
+      pos_(file_.data()),
+      end_(file_.data() + file_.size()),
+      format_(Format::SMS),
+      symmetry_(Symmetry::General),
+      pattern_(false),
+      height_(0),
+      width_(0),
+      remaining_(0),
+      has_mirror_(false),
+      mirror_i_(0),
+      mirror_j_(0)
+{
+  static const std::string banner = "%%MatrixMarket";
+
+  if (static_cast<std::size_t>(end_ - pos_) >= banner.size() &&
+      std::equal(banner.begin(), banner.end(), pos_)) {
+    format_ = Format::MatrixMarket;
+    pos_ += banner.size();
+    read_matrix_market_header();
+  } else {
+    read_sms_header();
+  }
+}
+
+void TripletReader::read_matrix_market_header()
+{
+  if (lower(read_word()) != "matrix") fail("only matrices are supported");
+  if (lower(read_word()) != "coordinate")
+    fail("only the coordinate format is supported");
+
+  const std::string field = lower(read_word());
+  if (field == "pattern")
+    pattern_ = true;
+  else if (field != "integer")
+    fail("only integer and pattern entries are supported");
+
+  const std::string symmetry = lower(read_word());
+  if (symmetry == "symmetric")
+    symmetry_ = Symmetry::Symmetric;
+  else if (symmetry == "skew-symmetric")
+    symmetry_ = Symmetry::SkewSymmetric;
+  else if (symmetry != "general")
+    fail("unsupported symmetry " + symmetry);
+  skip_line();
+
+  // Comment lines up to the size line.
+  while (true) {
+    skip_space();
+    if (pos_ == end_ || *pos_ != '%') break;
+    skip_line();
+  }
+
+  height_ = read_size();
+  width_ = read_size();
+  remaining_ = read_size();
+}
+
+void TripletReader::read_sms_header()
+{
+  height_ = read_size();
+  width_ = read_size();
+  // The third field names the coefficient domain; entries are integers.
+  read_word();
+  remaining_ = SIZE_MAX;
+}
+
+bool TripletReader::next(std::size_t& i, std::size_t& j, mpz_class& value)
+{
+  if (has_mirror_) {
+    has_mirror_ = false;
+    i = mirror_i_;
+    j = mirror_j_;
+    value = mirror_value_;
+    return true;
+  }
+
+  if (!remaining_) return false;
+
+  i = read_size();
+  j = read_size();
+
+  if (format_ == Format::SMS) {
+    read_integer(value);
+    // The SMS entry list ends with "0 0 0".
+    if (i == 0 && j == 0) {
+      remaining_ = 0;
+      return false;
+    }
+  } else {
+    --remaining_;
+    if (pattern_)
+      value = 1;
+    else
+      read_integer(value);
+  }
+
+  if (i == 0 || i > height_ || j == 0 || j > width_)
+    fail("entry index out of range");
+  --i;
+  --j;
+
+  if (symmetry_ != Symmetry::General && i != j) {
+    has_mirror_ = true;
+    mirror_i_ = j;
+    mirror_j_ = i;
+    mirror_value_ = value;
+    if (symmetry_ == Symmetry::SkewSymmetric) mirror_value_ = -mirror_value_;
+  }
+
+  return true;
+}
+
+void TripletReader::skip_space()
+{
+  while (pos_ != end_ && is_space(*pos_)) ++pos_;
+}
+
+void TripletReader::skip_line()
+{
+  while (pos_ != end_ && *pos_ != '\n') ++pos_;
+  if (pos_ != end_) ++pos_;
+}
+
+std::string TripletReader::read_word()
+{
+  skip_space();
+
+  const char* begin = pos_;
+  while (pos_ != end_ && !is_space(*pos_)) ++pos_;
+  if (begin == pos_) fail("unexpected end of file");
+
+  return std::string(begin, pos_);
+}
+
+std::size_t TripletReader::read_size()
+{
+  skip_space();
+  if (pos_ == end_ || !is_digit(*pos_)) fail("expected a nonnegative integer");
+
+  std::size_t size = 0;
+  for (; pos_ != end_ && is_digit(*pos_); ++pos_) {
+    const std::size_t digit = static_cast<std::size_t>(*pos_ - '0');
+    if (size > (SIZE_MAX - digit) / 10) fail("integer is too large");
+    size = 10 * size + digit;
+  }
+
+  return size;
+}
+
+void TripletReader::read_integer(mpz_class& value)
+{
+  skip_space();
+
+  const char* begin = pos_;
+  const bool negative = pos_ != end_ && *pos_ == '-';
+  if (pos_ != end_ && (*pos_ == '-' || *pos_ == '+')) ++pos_;
+
+  const char* digits = pos_;
+  while (pos_ != end_ && is_digit(*pos_)) ++pos_;
+  if (digits == pos_) fail("expected an integer");
+
+  if (static_cast<std::size_t>(pos_ - digits) <= WORD_DIGITS) {
+    std::int64_t x = 0;
+    for (const char* c = digits; c != pos_; ++c) x = 10 * x + (*c - '0');
+    mpz_set_si(value.get_mpz_t(), static_cast<long>(negative ? -x : x));
+    return;
+  }
+
+  // Only numbers beyond a word go through a (reused) string buffer.
+  scratch_.assign(*begin == '+' ? digits : begin, pos_);
+  mpz_set_str(value.get_mpz_t(), scratch_.c_str(), 10);
+}
+
+void TripletReader::fail(const std::string& message) const
+{
+  throw std::logic_error("TripletReader: " + message);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+
+#include <gmpxx.h>
+
+#include "mapped_file.h"
+#include "matrix.h"
+#include "sparse_matrix.h"
+
+// Streams the entries of a sparse matrix file, in MatrixMarket coordinate
+// format (integer or pattern, general, symmetric or skew-symmetric) or in the
+// SMS format of the SNF benchmark collections. The format is detected from the
+// first line. The file is memory mapped and parsed in place.
+class TripletReader
+{
+ public:
+  explicit TripletReader(const std::string& path);
+
+  TripletReader(const TripletReader&) = delete;
+  TripletReader& operator=(const TripletReader&) = delete;
+
+  inline std::size_t height() const
+  {
+    return height_;
+  }
+
+  inline std::size_t width() const
+  {
+    return width_;
+  }
+
+  // Reads the next entry, with zero-based indices. Returns false at the end of
+  // the matrix. Mirrored entries of symmetric matrices are returned as entries
+  // of their own.
+  bool next(std::size_t& i, std::size_t& j, mpz_class& value);
+
+ private:
+  enum class Format { MatrixMarket, SMS };
+  enum class Symmetry { General, Symmetric, SkewSymmetric };
+
+  void read_matrix_market_header();
+  void read_sms_header();
+
+  void skip_space();
+  void skip_line();
+  std::string read_word();
+  std::size_t read_size();
+  void read_integer(mpz_class& value);
+
+  [[noreturn]] void fail(const std::string& message) const;
+
+  MappedFile file_;
+  const char* pos_;
+  const char* end_;
+  std::string scratch_;
+
+  Format format_;
+  Symmetry symmetry_;
+  bool pattern_;
+  std::size_t height_;
+  std::size_t width_;
+  std::size_t remaining_;
+
+  bool has_mirror_;
+  std::size_t mirror_i_;
+  std::size_t mirror_j_;
+  mpz_class mirror_value_;
+};
+
+// Read a matrix file into a dense or a sparse matrix. T has to be
+// constructible from mpz_class.
+template <typename T>
+Matrix<T> read_matrix(const std::string& path);
+
+template <typename T>
+SparseMatrix<T> read_sparse_matrix(const std::string& path);
+
+#include "matrix_reader_impl.h"
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+template <typename T>
+Matrix<T> read_matrix(const std::string& path)
+{
+  TripletReader reader(path);
+  Matrix<T> f(reader.height(), reader.width());
+
+  std::size_t i, j;
+  mpz_class value;
+  while (reader.next(i, j, value)) {
+    f(i, j) = T(value);
+  }
+
+  return f;
+}
+
+template <typename T>
+SparseMatrix<T> read_sparse_matrix(const std::string& path)
+{
+  typedef typename SparseMatrix<T>::Entry Entry;
+
+  TripletReader reader(path);
+  std::vector<std::vector<Entry>> rows(reader.height());
+
+  // Entries are collected per row and sorted once, instead of being inserted
+  // into the sorted rows one by one.
+  std::size_t i, j;
+  mpz_class value;
+  while (reader.next(i, j, value)) {
+    rows[i].push_back(Entry{j, T(value)});
+  }
+
+  for (std::vector<Entry>& row : rows) {
+    std::stable_sort(row.begin(), row.end(),
+                     [](const Entry& a, const Entry& b) { return a.col < b.col; });
+
+    // Later entries override earlier ones at the same position, as with set.
+    std::size_t kept = 0;
+    for (std::size_t k = 0; k < row.size(); ++k) {
+      if (k + 1 < row.size() && row[k + 1].col == row[k].col) continue;
+      if (!row[k].value) continue;
+      if (kept != k) row[kept] = std::move(row[k]);
+      ++kept;
+    }
+    row.erase(row.begin() + static_cast<std::ptrdiff_t>(kept), row.end());
+  }
+
+  return SparseMatrix<T>(reader.width(), std::move(rows));
+}
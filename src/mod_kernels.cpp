@@ -0,0 +1,240 @@
+#include "mod_kernels.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define AKSS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// With lambda_shoup = floor(lambda * 2^32 / m), the quotient of lambda * x by
+// m for x < 2^32 is (x * lambda_shoup) >> 32 or one more, so the remainder
+// lambda * x - q * m lies in [0, 2m).
+inline std::uint64_t shoup(const std::uint64_t lambda, const std::uint64_t m)
+{
+  return (lambda << 32) / m;
+}
+
+inline std::uint64_t mul_shoup(const std::uint64_t x,
+                               const std::uint64_t lambda,
+                               const std::uint64_t lambda_shoup,
+                               const std::uint64_t m)
+{
+  const std::uint64_t r = x * lambda - ((x * lambda_shoup) >> 32) * m;
+  return r >= m ? r - m : r;
+}
+
+void add_mul_scalar(std::uint64_t* y, const std::uint64_t* x,
+                    const std::size_t n, const std::uint64_t lambda,
+                    const std::uint64_t lambda_shoup, const std::uint64_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    const std::uint64_t sum = y[k] + mul_shoup(x[k], lambda, lambda_shoup, m);
+    y[k] = sum >= m ? sum - m : sum;
+  }
+}
+
+void mul_scalar(std::uint64_t* x, const std::size_t n,
+                const std::uint64_t lambda, const std::uint64_t lambda_shoup,
+                const std::uint64_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    x[k] = mul_shoup(x[k], lambda, lambda_shoup, m);
+  }
+}
+
+#ifdef AKSS_X86_KERNELS
+
+// All intermediate values are below 2^34, so signed 64-bit comparisons work.
+__attribute__((target("avx2"))) inline __m256i reduce_avx2(const __m256i r,
+                                                          const __m256i m)
+{
+  const __m256i below = _mm256_cmpgt_epi64(m, r);
+  return _mm256_sub_epi64(r, _mm256_andnot_si256(below, m));
+}
+
+__attribute__((target("avx2"))) inline __m256i mul_shoup_avx2(
+    const __m256i x, const __m256i lambda, const __m256i lambda_shoup,
+    const __m256i m)
+{
+  const __m256i q = _mm256_srli_epi64(_mm256_mul_epu32(x, lambda_shoup), 32);
+  const __m256i r = _mm256_sub_epi64(_mm256_mul_epu32(x, lambda),
+                                     _mm256_mul_epu32(q, m));
+  return reduce_avx2(r, m);
+}
+
+__attribute__((target("avx2"))) void add_mul_avx2(
+    std::uint64_t* y, const std::uint64_t* x, const std::size_t n,
+    const std::uint64_t lambda, const std::uint64_t lambda_shoup,
+    const std::uint64_t m)
+{
+  const __m256i l = _mm256_set1_epi64x(static_cast<long long>(lambda));
+  const __m256i ls = _mm256_set1_epi64x(static_cast<long long>(lambda_shoup));
+  const __m256i mm = _mm256_set1_epi64x(static_cast<long long>(m));
+
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    const __m256i xk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + k));
+    const __m256i yk = _mm256_loadu_si256(reinterpret_cast<__m256i*>(y + k));
+    const __m256i sum = _mm256_add_epi64(yk, mul_shoup_avx2(xk, l, ls, mm));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + k),
+                        reduce_avx2(sum, mm));
+  }
+
+  add_mul_scalar(y + k, x + k, n - k, lambda, lambda_shoup, m);
+}
+
+__attribute__((target("avx2"))) void mul_avx2(std::uint64_t* x,
+                                              const std::size_t n,
+                                              const std::uint64_t lambda,
+                                              const std::uint64_t lambda_shoup,
+                                              const std::uint64_t m)
+{
+  const __m256i l = _mm256_set1_epi64x(static_cast<long long>(lambda));
+  const __m256i ls = _mm256_set1_epi64x(static_cast<long long>(lambda_shoup));
+  const __m256i mm = _mm256_set1_epi64x(static_cast<long long>(m));
+
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    const __m256i xk = _mm256_loadu_si256(reinterpret_cast<__m256i*>(x + k));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(x + k),
+                        mul_shoup_avx2(xk, l, ls, mm));
+  }
+
+  mul_scalar(x + k, n - k, lambda, lambda_shoup, m);
+}
+
+// r - m wraps around for r < m, so the unsigned minimum reduces r.
+__attribute__((target("avx512f"))) inline __m512i reduce_avx512(
+    const __m512i r, const __m512i m)
+{
+  return _mm512_min_epu64(r, _mm512_sub_epi64(r, m));
+}
+
+__attribute__((target("avx512f"))) inline __m512i mul_shoup_avx512(
+    const __m512i x, const __m512i lambda, const __m512i lambda_shoup,
+    const __m512i m)
+{
+  const __m512i q = _mm512_srli_epi64(_mm512_mul_epu32(x, lambda_shoup), 32);
+  const __m512i r = _mm512_sub_epi64(_mm512_mul_epu32(x, lambda),
+                                     _mm512_mul_epu32(q, m));
+  return reduce_avx512(r, m);
+}
+
+__attribute__((target("avx512f"))) void add_mul_avx512(
+    std::uint64_t* y, const std::uint64_t* x, const std::size_t n,
+    const std::uint64_t lambda, const std::uint64_t lambda_shoup,
+    const std::uint64_t m)
+{
+  const __m512i l = _mm512_set1_epi64(static_cast<long long>(lambda));
+  const __m512i ls = _mm512_set1_epi64(static_cast<long long>(lambda_shoup));
+  const __m512i mm = _mm512_set1_epi64(static_cast<long long>(m));
+
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const __m512i xk = _mm512_loadu_si512(x + k);
+    const __m512i yk = _mm512_loadu_si512(y + k);
+    const __m512i sum = _mm512_add_epi64(yk, mul_shoup_avx512(xk, l, ls, mm));
+    _mm512_storeu_si512(y + k, reduce_avx512(sum, mm));
+  }
+
+  add_mul_scalar(y + k, x + k, n - k, lambda, lambda_shoup, m);
+}
+
+__attribute__((target("avx512f"))) void mul_avx512(
+    std::uint64_t* x, const std::size_t n, const std::uint64_t lambda,
+    const std::uint64_t lambda_shoup, const std::uint64_t m)
+{
+  const __m512i l = _mm512_set1_epi64(static_cast<long long>(lambda));
+  const __m512i ls = _mm512_set1_epi64(static_cast<long long>(lambda_shoup));
+  const __m512i mm = _mm512_set1_epi64(static_cast<long long>(m));
+
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const __m512i xk = _mm512_loadu_si512(x + k);
+    _mm512_storeu_si512(x + k, mul_shoup_avx512(xk, l, ls, mm));
+  }
+
+  mul_scalar(x + k, n - k, lambda, lambda_shoup, m);
+}
+
+#endif
+
+bool supported(const ModKernels kernels)
+{
+#ifdef AKSS_X86_KERNELS
+  switch (kernels) {
+    case ModKernels::Scalar:
+      return true;
+    case ModKernels::Avx2:
+      return __builtin_cpu_supports("avx2");
+    case ModKernels::Avx512:
+      return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return kernels == ModKernels::Scalar;
+#endif
+}
+
+std::atomic<ModKernels>& selected()
+{
+  static std::atomic<ModKernels> kernels(
+      supported(ModKernels::Avx512)
+          ? ModKernels::Avx512
+          : supported(ModKernels::Avx2) ? ModKernels::Avx2
+                                        : ModKernels::Scalar);
+  return kernels;
+}
+
+}  // namespace
+
+ModKernels mod_kernels()
+{
+  return selected().load();
+}
+
+bool set_mod_kernels(const ModKernels kernels)
+{
+  if (!supported(kernels)) return false;
+
+  selected().store(kernels);
+  return true;
+}
+
+void mod_add_mul(std::uint64_t* y, const std::uint64_t* x, const std::size_t n,
+                 const std::uint64_t lambda, const std::uint64_t m)
+{
+  const std::uint64_t lambda_shoup = shoup(lambda, m);
+
+  switch (mod_kernels()) {
+#ifdef AKSS_X86_KERNELS
+    case ModKernels::Avx512:
+      return add_mul_avx512(y, x, n, lambda, lambda_shoup, m);
+    case ModKernels::Avx2:
+      return add_mul_avx2(y, x, n, lambda, lambda_shoup, m);
+#endif
+    default:
+      return add_mul_scalar(y, x, n, lambda, lambda_shoup, m);
+  }
+}
+
+void mod_mul(std::uint64_t* x, const std::size_t n, const std::uint64_t lambda,
+             const std::uint64_t m)
+{
+  const std::uint64_t lambda_shoup = shoup(lambda, m);
+
+  switch (mod_kernels()) {
+#ifdef AKSS_X86_KERNELS
+    case ModKernels::Avx512:
+      return mul_avx512(x, n, lambda, lambda_shoup, m);
+    case ModKernels::Avx2:
+      return mul_avx2(x, n, lambda, lambda_shoup, m);
+#endif
+    default:
+      return mul_scalar(x, n, lambda, lambda_shoup, m);
+  }
+}
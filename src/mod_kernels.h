@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Arithmetic on arrays of residues modulo m < 2^32, each stored in a 64-bit
+// word. Multiplications by the fixed factor lambda < m use Shoup's method, so
+// no division happens inside the loops, and are vectorized with AVX-512F or
+// AVX2 if the CPU supports them.
+
+enum class ModKernels {
+  Scalar,
+  Avx2,
+  Avx512,
+};
+
+// Instruction set the kernels use. The best one the CPU supports is picked on
+// first use; set_mod_kernels returns false without changing anything if
+// kernels is not supported. Must not be changed while kernels are running.
+ModKernels mod_kernels();
+bool set_mod_kernels(const ModKernels kernels);
+
+// y[k] = (y[k] + lambda * x[k]) mod m.
+void mod_add_mul(std::uint64_t* y, const std::uint64_t* x, const std::size_t n,
+                 const std::uint64_t lambda, const std::uint64_t m);
+
+// x[k] = (lambda * x[k]) mod m.
+void mod_mul(std::uint64_t* x, const std::size_t n, const std::uint64_t lambda,
+             const std::uint64_t m);
@@ -1,37 +1,218 @@
 #include "morphisms.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "abelian_group.h"
+#include "counters.h"
+#include "gmp_arena.h"
 #include "matrix.h"
 #include "p_local.h"
 #include "smith.h"
+#include "zpn.h"
 
-GroupWithMorphisms::GroupWithMorphisms(const std::size_t free_rank,
-                                       const std::size_t tor_rank)
-    : group(free_rank, tor_rank)
+namespace {
+
+// Transforms mapping from a basis only receive column operations during a
+// reduction, which are contiguous in ColMajor storage.
+using FromMatrixQ = Matrix<mpq_class, ColMajor>;
+using FromMatrixQList = MatrixList<mpq_class, ColMajor>;
+using FromMatrixQRefList = MatrixRefList<mpq_class, ColMajor>;
+
+std::atomic<bool>& use_arenas()
 {
+  static std::atomic<bool> enabled(false);
+  return enabled;
 }
 
-GroupWithMorphisms compute_cokernel(const std::size_t p, const MatrixQ& f,
-                                    const AbelianGroup& Y,
-                                    const MatrixQRefList& to_Y_ref,
-                                    const MatrixQRefList& from_Y_ref)
+std::atomic<bool>& use_reduction()
+{
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+std::atomic<bool>& use_words()
+{
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+// Reduces the maps of a result that go into its group.
+void reduce_maps_to(const std::size_t p, GroupWithMorphisms& result)
+{
+  if (!morphism_reduction()) return;
+
+  for (MatrixQ& f : result.maps_to) reduce_morphism(p, f, result.group);
+}
+
+// The given maps if request asks for their kind, and no maps otherwise.
+const MatrixQRefList& requested_maps(const MatrixQRefList& maps,
+                                     const MapRequest request,
+                                     const MapRequest kind)
+{
+  static const MatrixQRefList none;
+
+  return requested(request, kind) ? maps : none;
+}
+
+// Converts f to coefficients in Z/p^n. Returns false if some entry of f is not
+// p-integral.
+bool to_zpn(const std::size_t p, const MatrixQ& f, Matrix<Zpn>& g)
+{
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      const mpq_class& x = f(i, j);
+      if (mpz_divisible_ui_p(x.get_den_mpz_t(), p)) return false;
+      g(i, j) = x;
+    }
+  }
+
+  return true;
+}
+
+template <typename L>
+MatrixQ to_mpq(const Matrix<Zpn, L>& g)
+{
+  MatrixQ f(g.height(), g.width());
+
+  for (std::size_t i = 0; i < g.height(); ++i) {
+    for (std::size_t j = 0; j < g.width(); ++j) {
+      f(i, j) = g(i, j).get_mpz();
+    }
+  }
+
+  return f;
+}
+
+Matrix<Zpn> zpn_identity(const std::size_t n)
+{
+  Matrix<Zpn> id(n, n);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    id(i, i) = 1;
+  }
+
+  return id;
+}
+
+// Runs smith_reduce_p on the relation matrix f in word-sized Z/p^n
+// arithmetic, where max_order bounds the torsion exponents of all groups
+// involved. Instead of updating every transform, only one identity per
+// nonempty list is reduced, and the results are composed with the transforms
+// in exact arithmetic afterwards.
+//
+// Pivot divisions lose up to max_order digits of precision in the
+// transforms, so n = 2 * max_order + 1 digits are tracked. Returns false
+// without touching any argument if p^n does not fit into a word or f is not
+// p-integral.
+bool smith_reduce_p_word(const std::size_t p, const std::size_t max_order,
+                         MatrixQ& f, MatrixQRefList& to_X,
+                         FromMatrixQRefList& from_X, MatrixQRefList& to_Y,
+                         FromMatrixQRefList& from_Y)
+{
+  const std::size_t n = 2 * max_order + 1;
+  if (!Zpn::fits(p, n)) return false;
+
+  Zpn::Precision precision(p, n);
+
+  Matrix<Zpn> g(f.height(), f.width());
+  if (!to_zpn(p, f, g)) return false;
+
+  Matrix<Zpn> to_X_word = zpn_identity(to_X.empty() ? 0 : f.width());
+  Matrix<Zpn, ColMajor> from_X_word =
+      zpn_identity(from_X.empty() ? 0 : f.width());
+  Matrix<Zpn> to_Y_word = zpn_identity(to_Y.empty() ? 0 : f.height());
+  Matrix<Zpn, ColMajor> from_Y_word =
+      zpn_identity(from_Y.empty() ? 0 : f.height());
+
+  MatrixRefList<Zpn> to_X_ref;
+  MatrixRefList<Zpn, ColMajor> from_X_ref;
+  MatrixRefList<Zpn> to_Y_ref;
+  MatrixRefList<Zpn, ColMajor> from_Y_ref;
+  if (!to_X.empty()) to_X_ref.emplace_back(to_X_word);
+  if (!from_X.empty()) from_X_ref.emplace_back(from_X_word);
+  if (!to_Y.empty()) to_Y_ref.emplace_back(to_Y_word);
+  if (!from_Y.empty()) from_Y_ref.emplace_back(from_Y_word);
+
+  smith_reduce_p(p, g, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+
+  f = to_mpq(g);
+
+  if (!to_X.empty()) {
+    const MatrixQ t = to_mpq(to_X_word);
+    for (MatrixQ& h : to_X) h = t * h;
+  }
+  if (!from_X.empty()) {
+    const MatrixQ t = to_mpq(from_X_word);
+    for (FromMatrixQ& h : from_X) h = h * t;
+  }
+  if (!to_Y.empty()) {
+    const MatrixQ t = to_mpq(to_Y_word);
+    for (MatrixQ& h : to_Y) h = t * h;
+  }
+  if (!from_Y.empty()) {
+    const MatrixQ t = to_mpq(from_Y_word);
+    for (FromMatrixQ& h : from_Y) h = h * t;
+  }
+
+  return true;
+}
+
+MatrixQ relation_matrix(const std::size_t p, const MatrixQ& f,
+                        const AbelianGroup& Y)
 {
   MatrixQ f_rel_Y(f.height(), f.width() + Y.tor_rank());
   f_rel_Y(0, 0, f.height(), f.width()) = f;
   f_rel_Y(0, f.width(), Y.tor_rank(), Y.tor_rank()) = Y.torsion_matrix(p);
 
-  MatrixQList to_Y_copy = deref(to_Y_ref);
-  MatrixQList from_Y_copy = deref(from_Y_ref);
+  return f_rel_Y;
+}
 
-  MatrixQRefList to_X;
-  MatrixQRefList from_X;
-  MatrixQRefList to_Y_copy_ref = ref(to_Y_copy);
-  MatrixQRefList from_Y_copy_ref = ref(from_Y_copy);
+SparseMatrixQ relation_matrix(const std::size_t p, const SparseMatrixQ& f,
+                              const AbelianGroup& Y)
+{
+  SparseMatrixQ f_rel_Y(f.height(), f.width() + Y.tor_rank());
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (const SparseMatrixQ::Entry& entry : f.row(i)) {
+      f_rel_Y.set(i, entry.col, entry.value);
+    }
+  }
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    f_rel_Y.set(i, f.width() + i, mpq_class(p_pow_z(p, Y(i))));
+  }
+
+  return f_rel_Y;
+}
+
+// Brings the relation matrix into Smith normal form. If all groups involved
+// are finite, max_order is their largest torsion exponent.
+void reduce_relations(const std::size_t p, const bool finite,
+                      const std::size_t max_order, MatrixQ& f_rel_Y,
+                      MatrixQRefList& to_X, FromMatrixQRefList& from_X,
+                      MatrixQRefList& to_Y, FromMatrixQRefList& from_Y)
+{
+  if (!finite || !morphism_word_reduction() ||
+      !smith_reduce_p_word(p, max_order, f_rel_Y, to_X, from_X, to_Y, from_Y))
+    smith_reduce_p(p, f_rel_Y, to_X, from_X, to_Y, from_Y);
+}
 
-  smith_reduce_p(p, f_rel_Y, to_X, from_X, to_Y_copy_ref, from_Y_copy_ref);
+void reduce_relations(const std::size_t p, const bool, const std::size_t,
+                      SparseMatrixQ& f_rel_Y, MatrixQRefList& to_X,
+                      FromMatrixQRefList& from_X, MatrixQRefList& to_Y,
+                      FromMatrixQRefList& from_Y)
+{
+  smith_reduce_p(p, f_rel_Y, to_X, from_X, to_Y, from_Y);
+}
 
+// Reads off the cokernel from the Smith form f_rel_Y of the relation matrix
+// of Y, given the maps to and from Y transformed along with it.
+template <typename M>
+GroupWithMorphisms reduced_cokernel(const std::size_t p, const M& f_rel_Y,
+                                    MatrixQList& to_Y, FromMatrixQList& from_Y)
+{
   std::size_t rank_diff = 0;
   std::size_t torsion_rank = 0;
 
@@ -51,32 +232,49 @@ GroupWithMorphisms compute_cokernel(const std::size_t p, const MatrixQ& f,
     C.group(i - rank_diff) =
         static_cast<std::size_t>(p_val_q(p, f_rel_Y(i, i)));
 
-  for (MatrixQ& g_to_Y : to_Y_copy)
+  for (MatrixQ& g_to_Y : to_Y)
     C.maps_to.emplace_back(
         g_to_Y(rank_diff, 0, g_to_Y.height() - rank_diff, g_to_Y.width()));
 
-  for (MatrixQ& g_from_Y : from_Y_copy)
+  for (FromMatrixQ& g_from_Y : from_Y)
     C.maps_from.emplace_back(g_from_Y(0, rank_diff, g_from_Y.height(),
                                       g_from_Y.width() - rank_diff));
 
+  reduce_maps_to(p, C);
   return C;
 }
 
-GroupWithMorphisms compute_kernel(const std::size_t p, const MatrixQ& f,
-                                  const AbelianGroup& X, const AbelianGroup& Y,
-                                  const MatrixQRefList& to_X_ref,
-                                  const MatrixQRefList& from_X_ref)
+template <typename M, typename L>
+GroupWithMorphisms cokernel(const std::size_t p, const M& f,
+                            const AbelianGroup& Y,
+                            const MatrixQRefList& to_Y_ref,
+                            const MatrixRefList<mpq_class, L>& from_Y_ref)
 {
-  MatrixQ f_rel_Y(f.height(), f.width() + Y.tor_rank());
-  f_rel_Y(0, 0, f.height(), f.width()) = f;
-  f_rel_Y(0, f.width(), Y.tor_rank(), Y.tor_rank()) = Y.torsion_matrix(p);
+  M f_rel_Y = relation_matrix(p, f, Y);
 
+  MatrixQList to_Y_copy = deref(to_Y_ref);
+  FromMatrixQList from_Y_copy = deref<ColMajor>(from_Y_ref);
+
+  MatrixQRefList to_X;
+  FromMatrixQRefList from_X;
+  MatrixQRefList to_Y_copy_ref = ref(to_Y_copy);
+  FromMatrixQRefList from_Y_copy_ref = ref(from_Y_copy);
+
+  reduce_relations(p, Y.free_rank() == 0, Y.max_order(), f_rel_Y, to_X,
+                   from_X, to_Y_copy_ref, from_Y_copy_ref);
+
+  return reduced_cokernel(p, f_rel_Y, to_Y_copy, from_Y_copy);
+}
+
+// Lift of the relations of X to the domain of the relation matrix of Y. Its
+// lower block is minus the lift of f o rel_X over rel_Y, obtained by
+// multiplying the columns of f with the orders of X and dividing its rows by
+// the orders of Y.
+MatrixQ relation_lift(const std::size_t p, const MatrixQ& f,
+                      const AbelianGroup& X, const AbelianGroup& Y)
+{
   MatrixQ rel_x_lift(f.width() + Y.tor_rank(), X.tor_rank());
   rel_x_lift(0, 0, X.tor_rank(), X.tor_rank()) = X.torsion_matrix(p);
-  // rel_x_lift(f.width(), 0, Y.tor_rank(), X.tor_rank()) = -lift of f\circ
-  // rel_x over rel_Y.
-  //      Can be computed by multiplying the columns of f with the orders of X,
-  //      and dividing the rows by the orders of Y.
 
   for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
     for (std::size_t j = 0; j < X.tor_rank(); ++j) {
@@ -85,35 +283,151 @@ GroupWithMorphisms compute_kernel(const std::size_t p, const MatrixQ& f,
     }
   }
 
-  // build to_X_rel_Y, from_X_rel_Y.
-  MatrixQList to_X_rel_Y;
-  for (MatrixQ& g_to_X : to_X_ref) {
-    to_X_rel_Y.emplace_back(f.width() + Y.tor_rank(), g_to_X.width());
-    to_X_rel_Y.back()(0, 0, f.width(), g_to_X.width()) = g_to_X;
+  return rel_x_lift;
+}
 
-    MatrixQ fg = f * g_to_X;
-    for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+// Sparse variant, built from the entries of f between torsion generators.
+SparseMatrixQ relation_lift(const std::size_t p, const SparseMatrixQ& f,
+                            const AbelianGroup& X, const AbelianGroup& Y)
+{
+  std::vector<std::vector<SparseMatrixQ::Entry>> rows(f.width() +
+                                                      Y.tor_rank());
+  for (std::size_t j = 0; j < X.tor_rank(); ++j)
+    rows[j].push_back({j, mpq_class(p_pow_z(p, X(j)))});
+
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    for (const SparseMatrixQ::Entry& entry : f.row(i)) {
+      if (entry.col >= X.tor_rank()) break;
+      long order_diff = static_cast<long>(X(entry.col) - Y(i));
+      rows[f.width() + i].push_back(
+          {entry.col, -entry.value * p_pow_q(p, order_diff)});
+    }
+  }
+
+  return SparseMatrixQ(X.tor_rank(), std::move(rows));
+}
+
+// Minus the rows of f * g_to_X mapping to the torsion of Y, divided by the
+// orders of Y.
+MatrixQ torsion_lift(const std::size_t p, const MatrixQ& f,
+                     const AbelianGroup& Y, const MatrixQ& g_to_X)
+{
+  MatrixQ fg = f * g_to_X;
+  MatrixQ lift(Y.tor_rank(), g_to_X.width());
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    for (std::size_t j = 0; j < g_to_X.width(); ++j) {
+      lift(i, j) = -fg(i, j) / p_pow_z(p, Y(i));
+    }
+  }
+
+  return lift;
+}
+
+MatrixQ torsion_lift(const std::size_t p, const SparseMatrixQ& f,
+                     const AbelianGroup& Y, const MatrixQ& g_to_X)
+{
+  MatrixQ lift(Y.tor_rank(), g_to_X.width());
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    for (const SparseMatrixQ::Entry& entry : f.row(i)) {
       for (std::size_t j = 0; j < g_to_X.width(); ++j) {
-        to_X_rel_Y.back()(f.width() + i, j) = -fg(i, j) / p_pow_z(p, Y(i));
+        lift(i, j) -= entry.value * g_to_X(entry.col, j);
       }
     }
+    const mpq_class order(p_pow_z(p, Y(i)));
+    for (std::size_t j = 0; j < g_to_X.width(); ++j) lift(i, j) /= order;
+  }
+
+  return lift;
+}
+
+// Column side of the kernel computation: rel_x_lift lifts the relations of X
+// to the domain of the relation matrix of Y, and to_X_rel_Y and from_X_rel_Y
+// extend the given maps to and from X to that domain.
+template <typename M>
+struct KernelLifts {
+  KernelLifts(const std::size_t p, const M& f, const AbelianGroup& X,
+              const AbelianGroup& Y, const MatrixQRefList& to_X_ref,
+              const MatrixQRefList& from_X_ref);
+
+  M rel_x_lift;
+  MatrixQList to_X_rel_Y;
+  FromMatrixQList from_X_rel_Y;
+};
+
+template <typename M>
+KernelLifts<M>::KernelLifts(const std::size_t p, const M& f,
+                            const AbelianGroup& X, const AbelianGroup& Y,
+                            const MatrixQRefList& to_X_ref,
+                            const MatrixQRefList& from_X_ref)
+    : rel_x_lift(relation_lift(p, f, X, Y))
+{
+  for (MatrixQ& g_to_X : to_X_ref) {
+    to_X_rel_Y.emplace_back(f.width() + Y.tor_rank(), g_to_X.width());
+    to_X_rel_Y.back()(0, 0, f.width(), g_to_X.width()) = g_to_X;
+    to_X_rel_Y.back()(f.width(), 0, Y.tor_rank(), g_to_X.width()) =
+        torsion_lift(p, f, Y, g_to_X);
   }
 
-  MatrixQList from_X_rel_Y;
   for (MatrixQ& g_from_X : from_X_ref) {
     from_X_rel_Y.emplace_back(g_from_X.height(), f.width() + Y.tor_rank());
     from_X_rel_Y.back()(0, 0, g_from_X.height(), f.width()) = g_from_X;
   }
+}
 
-  MatrixQRefList to_X_rel_Y_ref = ref(to_X_rel_Y);
-  MatrixQRefList from_X_rel_Y_ref = ref(from_X_rel_Y);
+// Brings the relation matrix of Y into Smith normal form, transforming the
+// kernel lifts and the maps to and from Y along with it.
+void reduce_kernel_relations(const std::size_t p, const bool finite,
+                             const std::size_t max_order, MatrixQ& f_rel_Y,
+                             KernelLifts<MatrixQ>& lifts, MatrixQRefList& to_Y,
+                             FromMatrixQRefList& from_Y)
+{
+  MatrixQRefList to_X_rel_Y_ref = ref(lifts.to_X_rel_Y);
+  FromMatrixQRefList from_X_rel_Y_ref = ref(lifts.from_X_rel_Y);
 
-  to_X_rel_Y_ref.emplace_back(rel_x_lift);
+  to_X_rel_Y_ref.emplace_back(lifts.rel_x_lift);
 
-  MatrixQRefList to_Y;
-  MatrixQRefList from_Y;
-  smith_reduce_p(p, f_rel_Y, to_X_rel_Y_ref, from_X_rel_Y_ref, to_Y, from_Y);
+  reduce_relations(p, finite, max_order, f_rel_Y, to_X_rel_Y_ref,
+                   from_X_rel_Y_ref, to_Y, from_Y);
+}
+
+// The sparse rel_x_lift cannot join the dense maps to X, so the column
+// operations are logged and replayed on it separately.
+void reduce_kernel_relations(const std::size_t p, const bool, const std::size_t,
+                             SparseMatrixQ& f_rel_Y,
+                             KernelLifts<SparseMatrixQ>& lifts,
+                             MatrixQRefList& to_Y, FromMatrixQRefList& from_Y)
+{
+  TransformLog<mpq_class> log_X;
+  TransformLog<mpq_class> log_Y(!to_Y.empty() || !from_Y.empty());
+  smith_reduce_p(p, f_rel_Y, log_X, log_Y);
+
+  MatrixQRefList to_X_rel_Y_ref = ref(lifts.to_X_rel_Y);
+  FromMatrixQRefList from_X_rel_Y_ref = ref(lifts.from_X_rel_Y);
+
+  log_X.apply(to_X_rel_Y_ref, from_X_rel_Y_ref, smith_thread_pool());
+  log_X.apply_to(lifts.rel_x_lift);
+  log_Y.apply(to_Y, from_Y, smith_thread_pool());
+}
+
+MatrixQ rows_from(MatrixQ& f, const std::size_t i)
+{
+  return f(i, 0, f.height() - i, f.width());
+}
 
+SparseMatrixQ rows_from(const SparseMatrixQ& f, const std::size_t i)
+{
+  std::vector<std::vector<SparseMatrixQ::Entry>> rows;
+  for (std::size_t k = i; k < f.height(); ++k) rows.push_back(f.row(k));
+
+  return SparseMatrixQ(f.width(), std::move(rows));
+}
+
+// Reads off the kernel from the Smith form f_rel_Y of the relation matrix of
+// Y, given the lifts transformed along with it.
+template <typename M>
+GroupWithMorphisms reduced_kernel(const std::size_t p, const M& f_rel_Y,
+                                  KernelLifts<M>& lifts)
+{
   std::size_t rank_diff;
   for (rank_diff = 0; rank_diff < std::min(f_rel_Y.height(), f_rel_Y.width());
        ++rank_diff) {
@@ -127,43 +441,444 @@ GroupWithMorphisms compute_kernel(const std::size_t p, const MatrixQ& f,
   // by the corresponding rows. For from_X_rel_Y, take the submatrices formed
   // by
   // the corresponding columns.
-  MatrixQ rel_K = rel_x_lift(rank_diff, 0, rel_x_lift.height() - rank_diff,
-                             rel_x_lift.width());
+  M rel_K = rows_from(lifts.rel_x_lift, rank_diff);
   MatrixQList to_free_K;
-  for (MatrixQ& g_to_X_rel_Y : to_X_rel_Y) {
+  for (MatrixQ& g_to_X_rel_Y : lifts.to_X_rel_Y) {
     to_free_K.emplace_back(g_to_X_rel_Y(
         rank_diff, 0, g_to_X_rel_Y.height() - rank_diff, g_to_X_rel_Y.width()));
   }
-  MatrixQList from_free_K;
+  FromMatrixQList from_free_K;
 
-  for (MatrixQ& g_from_X_rel_Y : from_X_rel_Y) {
+  for (FromMatrixQ& g_from_X_rel_Y : lifts.from_X_rel_Y) {
     from_free_K.emplace_back(
         g_from_X_rel_Y(0, rank_diff, g_from_X_rel_Y.height(),
                        g_from_X_rel_Y.width() - rank_diff));
   }
 
   MatrixQRefList to_free_K_ref = ref(to_free_K);
-  MatrixQRefList from_free_K_ref = ref(from_free_K);
+  FromMatrixQRefList from_free_K_ref = ref(from_free_K);
 
   AbelianGroup free_K(rel_K.height(), 0);
   // then, compute the cokernel of the new rel_x_lift with the respective
   // to_Y, from_Y.
-  return compute_cokernel(p, rel_K, free_K, to_free_K_ref, from_free_K_ref);
+  return cokernel(p, rel_K, free_K, to_free_K_ref, from_free_K_ref);
 }
 
-GroupWithMorphisms compute_image(const std::size_t p, const MatrixQ& f,
-                                 const AbelianGroup& X, const AbelianGroup& Y)
+template <typename M>
+GroupWithMorphisms kernel(const std::size_t p, const M& f,
+                          const AbelianGroup& X, const AbelianGroup& Y,
+                          const MatrixQRefList& to_X_ref,
+                          const MatrixQRefList& from_X_ref)
 {
-  MatrixQRefList to_X;
-  MatrixQList from_X = {MatrixQ::identity(f.width())};
-  GroupWithMorphisms K = compute_kernel(p, f, X, Y, to_X, ref(from_X));
+  M f_rel_Y = relation_matrix(p, f, Y);
+  KernelLifts<M> lifts(p, f, X, Y, to_X_ref, from_X_ref);
+
+  MatrixQRefList to_Y;
+  FromMatrixQRefList from_Y;
+  reduce_kernel_relations(p, X.free_rank() == 0 && Y.free_rank() == 0,
+                          std::max(X.max_order(), Y.max_order()), f_rel_Y,
+                          lifts, to_Y, from_Y);
 
-  MatrixQList to_X_2 = {MatrixQ::identity(f.width())};
-  MatrixQList from_X_2 = {f};
-  GroupWithMorphisms img =
-      compute_cokernel(p, f, Y, ref(to_X_2), ref(from_X_2));
+  return reduced_kernel(p, f_rel_Y, lifts);
+}
+
+// The kernel needs the column operations and the cokernel the row operations
+// of the same reduction of the relation matrix of Y, so both are tracked at
+// once.
+template <typename M>
+KernelAndCokernel kernel_cokernel(const std::size_t p, const M& f,
+                                  const AbelianGroup& X, const AbelianGroup& Y,
+                                  const MatrixQRefList& to_X_ref,
+                                  const MatrixQRefList& from_X_ref,
+                                  const MatrixQRefList& to_Y_ref,
+                                  const MatrixQRefList& from_Y_ref)
+{
+  M f_rel_Y = relation_matrix(p, f, Y);
+  KernelLifts<M> lifts(p, f, X, Y, to_X_ref, from_X_ref);
+
+  MatrixQList to_Y_copy = deref(to_Y_ref);
+  FromMatrixQList from_Y_copy = deref<ColMajor>(from_Y_ref);
+
+  MatrixQRefList to_Y_copy_ref = ref(to_Y_copy);
+  FromMatrixQRefList from_Y_copy_ref = ref(from_Y_copy);
+
+  reduce_kernel_relations(p, X.free_rank() == 0 && Y.free_rank() == 0,
+                          std::max(X.max_order(), Y.max_order()), f_rel_Y,
+                          lifts, to_Y_copy_ref, from_Y_copy_ref);
+
+  return {reduced_kernel(p, f_rel_Y, lifts),
+          reduced_cokernel(p, f_rel_Y, to_Y_copy, from_Y_copy)};
+}
+
+// Free part of the image of f. The free rows F of f are reduced on their own:
+// reducing all of f at once would add torsion rows to free rows, which is no
+// automorphism of Y. If U F S = D has r nonzero diagonal entries, the first r
+// columns of f S generate a free summand of the image, and D^-1 U F gives the
+// coordinates in it.
+struct FreeImage {
+  MatrixQ coordinates;
+  FromMatrixQ generators;
+};
+
+FreeImage free_image(const std::size_t p, const MatrixQ& f,
+                     const AbelianGroup& X, const AbelianGroup& Y)
+{
+  if (X.free_rank() == 0 || Y.free_rank() == 0)
+    return {MatrixQ(0, f.width()), FromMatrixQ(f.height(), 0)};
+
+  MatrixQ F(Y.free_rank(), f.width());
+  for (std::size_t i = 0; i < F.height(); ++i) {
+    for (std::size_t j = 0; j < F.width(); ++j) {
+      F(i, j) = f(Y.tor_rank() + i, j);
+    }
+  }
+
+  MatrixQList to_Y = {F};
+  FromMatrixQList from_X;
+  from_X.emplace_back(MatrixQ(f));
+  MatrixQRefList to_X_ref;
+  FromMatrixQRefList from_X_ref = ref(from_X);
+  MatrixQRefList to_Y_ref = ref(to_Y);
+  FromMatrixQRefList from_Y_ref;
+
+  smith_reduce_p(p, F, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+
+  std::size_t rank = 0;
+  while (rank < std::min(F.height(), F.width()) && F(rank, rank) != 0) ++rank;
+
+  MatrixQ coordinates(rank, f.width());
+  for (std::size_t k = 0; k < rank; ++k) {
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      coordinates(k, j) = to_Y[0](k, j) / F(k, k);
+    }
+  }
+
+  return {coordinates, from_X[0](0, 0, f.height(), rank)};
+}
+
+GroupWithMorphisms image(const std::size_t p, const MatrixQ& f,
+                         const AbelianGroup& X, const AbelianGroup& Y,
+                         const MapRequest request)
+{
+  const bool to = requested(request, MapRequest::MapsTo);
+  const bool from = requested(request, MapRequest::MapsFrom);
+
+  // Subtracting the free part of the image leaves t, which vanishes on the
+  // free rows of Y. Without a free part, the free rows of f vanish already.
+  const FreeImage free_part = free_image(p, f, X, Y);
+  const MatrixQ& lambda = free_part.coordinates;
+
+  MatrixQ t = f;
+  if (lambda.height() != 0) {
+    for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        for (std::size_t k = 0; k < lambda.height(); ++k) {
+          t(i, j) -= free_part.generators(i, k) * lambda(k, j);
+        }
+      }
+    }
+    for (std::size_t i = Y.tor_rank(); i < f.height(); ++i) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        t(i, j) = 0;
+      }
+    }
+  }
+
+  // The image of t lies in the torsion of Y, which embeds into
+  // (Z/p^N)^tor_rank by multiplying the i-th generator with p^(N - Y(i)).
+  // If T g S = D is the Smith form of the embedded map g, the image of t is
+  // the sum of the cyclic groups generated by the columns of t S whose
+  // diagonal entry is nonzero modulo p^N, and D S^-1 = T g gives the
+  // projection.
+  const std::size_t N = Y.tor_rank() ? Y.max_order() : 0;
+
+  MatrixQ g(Y.tor_rank(), f.width());
+  for (std::size_t i = 0; i < Y.tor_rank(); ++i) {
+    const mpz_class scale = p_pow_z(p, N - Y(i));
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      g(i, j) = t(i, j) * scale;
+    }
+  }
+
+  MatrixQList to_Y;
+  if (to) to_Y.push_back(g);
+  FromMatrixQList from_X;
+  if (from) from_X.emplace_back(MatrixQ(t));
+  MatrixQRefList to_Y_ref = ref(to_Y);
+  FromMatrixQRefList from_X_ref = ref(from_X);
+  MatrixQRefList to_X_ref;
+  FromMatrixQRefList from_Y_ref;
+
+  reduce_relations(p, true, N, g, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+
+  std::size_t rank;
+  for (rank = 0; rank < std::min(g.height(), g.width()); ++rank) {
+    if (g(rank, rank) == 0 ||
+        static_cast<std::size_t>(p_val_q(p, g(rank, rank))) >= N)
+      break;
+  }
+
+  // As in every AbelianGroup, the torsion generators come first.
+  GroupWithMorphisms I(lambda.height(), rank);
+  for (std::size_t k = 0; k < rank; ++k) {
+    I.group(k) = N - static_cast<std::size_t>(p_val_q(p, g(k, k)));
+  }
+
+  if (to) {
+    MatrixQ projection(rank + lambda.height(), f.width());
+    for (std::size_t k = 0; k < rank; ++k) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        projection(k, j) = to_Y[0](k, j) / g(k, k);
+      }
+    }
+    for (std::size_t k = 0; k < lambda.height(); ++k) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        projection(rank + k, j) = lambda(k, j);
+      }
+    }
+    I.maps_to.emplace_back(projection);
+    reduce_maps_to(p, I);
+  }
+
+  if (from) {
+    MatrixQ inclusion(f.height(), rank + lambda.height());
+    for (std::size_t i = 0; i < f.height(); ++i) {
+      for (std::size_t k = 0; k < rank; ++k) {
+        inclusion(i, k) = from_X[0](i, k);
+      }
+      for (std::size_t k = 0; k < lambda.height(); ++k) {
+        inclusion(i, rank + k) = free_part.generators(i, k);
+      }
+    }
+    I.maps_from.emplace_back(inclusion);
+    if (morphism_reduction()) reduce_morphism(p, I.maps_from[0], Y);
+  }
+
+  return I;
+}
+
+// Gives the matrices of a result their own entries.
+void detach(GroupWithMorphisms& result)
+{
+  for (MatrixQ& f : result.maps_to) f.detach();
+  for (MatrixQ& f : result.maps_from) f.detach();
+}
+
+void detach(KernelAndCokernel& result)
+{
+  detach(result.kernel);
+  detach(result.cokernel);
+}
+
+// Runs compute with GMP temporaries in an arena if enabled, copying the result
+// to the heap before the arena is released.
+template <typename F>
+auto in_arena(F compute) -> decltype(compute())
+{
+  typedef decltype(compute()) Result;
+
+  if (!morphism_arenas()) return compute();
+
+  GmpArena arena;
+  GmpArena::Scope scope(arena);
+  const Result result = compute();
+
+  GmpArena::Suspend suspend;
+  Result copy(result);
+  detach(copy);
+  return copy;
+}
+
+}  // namespace
+
+GroupWithMorphisms::GroupWithMorphisms(const std::size_t free_rank,
+                                       const std::size_t tor_rank)
+    : group(free_rank, tor_rank)
+{
+}
+
+MapRequest operator|(const MapRequest a, const MapRequest b)
+{
+  return static_cast<MapRequest>(static_cast<unsigned>(a) |
+                                 static_cast<unsigned>(b));
+}
+
+bool requested(const MapRequest request, const MapRequest maps)
+{
+  return (static_cast<unsigned>(request) & static_cast<unsigned>(maps)) != 0;
+}
+
+void set_morphism_arenas(const bool enabled)
+{
+  if (enabled) GmpArena::install();
+  use_arenas().store(enabled);
+}
+
+bool morphism_arenas()
+{
+  return use_arenas().load();
+}
+
+void set_morphism_reduction(const bool enabled)
+{
+  use_reduction().store(enabled);
+}
+
+bool morphism_reduction()
+{
+  return use_reduction().load();
+}
+
+void set_morphism_word_reduction(const bool enabled)
+{
+  use_words().store(enabled);
+}
+
+bool morphism_word_reduction()
+{
+  return use_words().load();
+}
+
+void reduce_morphism(const std::size_t p, MatrixQ& f, const AbelianGroup& Y)
+{
+  const MatrixQ& entries = f;
+  mpz_class modulus;
+  mpz_class inverse;
+
+  for (std::size_t i = 0; i < std::min(f.height(), Y.tor_rank()); ++i) {
+    modulus = p_pow_z(p, Y(i));
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      const mpq_class& x = entries(i, j);
+      // Representatives are only read, since writing through f detaches
+      // entries it shares with other matrices.
+      if (x.get_den() == 1 && sgn(x) >= 0 && x.get_num() < modulus) continue;
+      if (mpz_divisible_ui_p(x.get_den_mpz_t(), p)) continue;
+
+      mpz_class r = x.get_num();
+      if (x.get_den() != 1) {
+        mpz_invert(inverse.get_mpz_t(), x.get_den_mpz_t(),
+                   modulus.get_mpz_t());
+        r *= inverse;
+      }
+      mpz_fdiv_r(r.get_mpz_t(), r.get_mpz_t(), modulus.get_mpz_t());
+      f(i, j) = r;
+    }
+  }
+}
+
+GroupWithMorphisms compute_cokernel(const std::size_t p, const MatrixQ& f,
+                                    const AbelianGroup& Y,
+                                    const MatrixQRefList& to_Y_ref,
+                                    const MatrixQRefList& from_Y_ref,
+                                    const MapRequest request)
+{
+  AKSS_COUNTER_SCOPE("compute_cokernel");
+
+  return in_arena([&]() {
+    return cokernel(p, f, Y,
+                    requested_maps(to_Y_ref, request, MapRequest::MapsTo),
+                    requested_maps(from_Y_ref, request, MapRequest::MapsFrom));
+  });
+}
+
+GroupWithMorphisms compute_cokernel(const std::size_t p,
+                                    const SparseMatrixQ& f,
+                                    const AbelianGroup& Y,
+                                    const MatrixQRefList& to_Y_ref,
+                                    const MatrixQRefList& from_Y_ref,
+                                    const MapRequest request)
+{
+  AKSS_COUNTER_SCOPE("compute_cokernel");
+
+  return in_arena([&]() {
+    return cokernel(p, f, Y,
+                    requested_maps(to_Y_ref, request, MapRequest::MapsTo),
+                    requested_maps(from_Y_ref, request, MapRequest::MapsFrom));
+  });
+}
+
+GroupWithMorphisms compute_kernel(const std::size_t p, const MatrixQ& f,
+                                  const AbelianGroup& X, const AbelianGroup& Y,
+                                  const MatrixQRefList& to_X_ref,
+                                  const MatrixQRefList& from_X_ref,
+                                  const MapRequest request)
+{
+  AKSS_COUNTER_SCOPE("compute_kernel");
+
+  return in_arena([&]() {
+    return kernel(p, f, X, Y,
+                  requested_maps(to_X_ref, request, MapRequest::MapsTo),
+                  requested_maps(from_X_ref, request, MapRequest::MapsFrom));
+  });
+}
+
+GroupWithMorphisms compute_kernel(const std::size_t p, const SparseMatrixQ& f,
+                                  const AbelianGroup& X, const AbelianGroup& Y,
+                                  const MatrixQRefList& to_X_ref,
+                                  const MatrixQRefList& from_X_ref,
+                                  const MapRequest request)
+{
+  AKSS_COUNTER_SCOPE("compute_kernel");
+
+  return in_arena([&]() {
+    return kernel(p, f, X, Y,
+                  requested_maps(to_X_ref, request, MapRequest::MapsTo),
+                  requested_maps(from_X_ref, request, MapRequest::MapsFrom));
+  });
+}
+
+KernelAndCokernel compute_kernel_cokernel(const std::size_t p, const MatrixQ& f,
+                                         const AbelianGroup& X,
+                                         const AbelianGroup& Y,
+                                         const MatrixQRefList& to_X_ref,
+                                         const MatrixQRefList& from_X_ref,
+                                         const MatrixQRefList& to_Y_ref,
+                                         const MatrixQRefList& from_Y_ref,
+                                         const MapRequest kernel_request,
+                                         const MapRequest cokernel_request)
+{
+  AKSS_COUNTER_SCOPE("compute_kernel_cokernel");
+
+  return in_arena([&]() {
+    return kernel_cokernel(
+        p, f, X, Y,
+        requested_maps(to_X_ref, kernel_request, MapRequest::MapsTo),
+        requested_maps(from_X_ref, kernel_request, MapRequest::MapsFrom),
+        requested_maps(to_Y_ref, cokernel_request, MapRequest::MapsTo),
+        requested_maps(from_Y_ref, cokernel_request, MapRequest::MapsFrom));
+  });
+}
+
+KernelAndCokernel compute_kernel_cokernel(const std::size_t p,
+                                         const SparseMatrixQ& f,
+                                         const AbelianGroup& X,
+                                         const AbelianGroup& Y,
+                                         const MatrixQRefList& to_X_ref,
+                                         const MatrixQRefList& from_X_ref,
+                                         const MatrixQRefList& to_Y_ref,
+                                         const MatrixQRefList& from_Y_ref,
+                                         const MapRequest kernel_request,
+                                         const MapRequest cokernel_request)
+{
+  AKSS_COUNTER_SCOPE("compute_kernel_cokernel");
+
+  return in_arena([&]() {
+    return kernel_cokernel(
+        p, f, X, Y,
+        requested_maps(to_X_ref, kernel_request, MapRequest::MapsTo),
+        requested_maps(from_X_ref, kernel_request, MapRequest::MapsFrom),
+        requested_maps(to_Y_ref, cokernel_request, MapRequest::MapsTo),
+        requested_maps(from_Y_ref, cokernel_request, MapRequest::MapsFrom));
+  });
+}
+
+GroupWithMorphisms compute_image(const std::size_t p, const MatrixQ& f,
+                                 const AbelianGroup& X, const AbelianGroup& Y,
+                                 const MapRequest request)
+{
+  AKSS_COUNTER_SCOPE("compute_image");
 
-  return img;
+  return in_arena([&]() { return image(p, f, X, Y, request); });
 }
 
 bool morphism_equal(std::size_t p, const MatrixQ& f, const MatrixQ& g,
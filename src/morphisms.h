@@ -2,6 +2,7 @@
 
 #include "abelian_group.h"
 #include "matrix.h"
+#include "sparse_matrix.h"
 
 struct GroupWithMorphisms {
  public:
@@ -12,19 +13,114 @@ struct GroupWithMorphisms {
   MatrixQList maps_from;
 };
 
+// Maps a caller needs from compute_cokernel, compute_kernel,
+// compute_kernel_cokernel or compute_image. Transforms of a kind that is not
+// requested are ignored: they are neither built nor updated during the
+// reduction, and the corresponding list of the result stays empty. None only
+// computes the group.
+enum class MapRequest : unsigned {
+  None = 0,
+  MapsTo = 1,
+  MapsFrom = 2,
+  All = MapsTo | MapsFrom,
+};
+
+MapRequest operator|(const MapRequest a, const MapRequest b);
+// Whether request asks for some of maps.
+bool requested(const MapRequest request, const MapRequest maps);
+
+// Whether compute_kernel, compute_cokernel, compute_kernel_cokernel and
+// compute_image allocate their GMP temporaries in a GmpArena released at the
+// end of each call. Off by default. Turning it on installs the allocation
+// functions of GmpArena, so no other thread may use GMP during that call.
+void set_morphism_arenas(const bool enabled);
+bool morphism_arenas();
+
+// Whether the maps into the results of compute_cokernel, compute_kernel,
+// compute_kernel_cokernel and compute_image, and the matrices kept by
+// SpectralSequence, are reduced with reduce_morphism. On by default.
+void set_morphism_reduction(const bool enabled);
+bool morphism_reduction();
+
+// Whether compute_cokernel, compute_kernel, compute_kernel_cokernel and
+// compute_image reduce dense matrices over finite groups with coefficients in
+// Z/p^(2N + 1) instead of the rationals. On by default; turning it off is
+// only useful to check the two against each other.
+void set_morphism_word_reduction(const bool enabled);
+bool morphism_word_reduction();
+
+// Replaces the p-integral entries in the torsion rows of f: X -> Y by their
+// representatives in [0, p^Y(i)), which does not change f as a morphism. Row i
+// only carries precision Y(i), so the entries stay bounded however many maps
+// f is composed of. Free rows are kept exactly.
+void reduce_morphism(const std::size_t p, MatrixQ& f, const AbelianGroup& Y);
+
 GroupWithMorphisms compute_cokernel(const std::size_t p, const MatrixQ& f,
                                     const AbelianGroup& Y,
                                     const MatrixQRefList& to_Y_ref,
-                                    const MatrixQRefList& from_Y_ref);
+                                    const MatrixQRefList& from_Y_ref,
+                                    const MapRequest request = MapRequest::All);
+
+GroupWithMorphisms compute_cokernel(const std::size_t p,
+                                    const SparseMatrixQ& f,
+                                    const AbelianGroup& Y,
+                                    const MatrixQRefList& to_Y_ref,
+                                    const MatrixQRefList& from_Y_ref,
+                                    const MapRequest request = MapRequest::All);
 
 GroupWithMorphisms compute_kernel(const std::size_t p, const MatrixQ& f,
                                   const AbelianGroup& X, const AbelianGroup& Y,
                                   const MatrixQRefList& to_X_ref,
-                                  const MatrixQRefList& from_X_ref);
+                                  const MatrixQRefList& from_X_ref,
+                                  const MapRequest request = MapRequest::All);
+
+GroupWithMorphisms compute_kernel(const std::size_t p, const SparseMatrixQ& f,
+                                  const AbelianGroup& X, const AbelianGroup& Y,
+                                  const MatrixQRefList& to_X_ref,
+                                  const MatrixQRefList& from_X_ref,
+                                  const MapRequest request = MapRequest::All);
+
+struct KernelAndCokernel {
+  GroupWithMorphisms kernel;
+  GroupWithMorphisms cokernel;
+};
+
+// Kernel and cokernel of f: X -> Y, sharing the reduction of the relation
+// matrix of Y. Same as compute_kernel(p, f, X, Y, to_X_ref, from_X_ref) and
+// compute_cokernel(p, f, Y, to_Y_ref, from_Y_ref), with separate requests for
+// the maps of the kernel and of the cokernel.
+KernelAndCokernel compute_kernel_cokernel(const std::size_t p, const MatrixQ& f,
+                                         const AbelianGroup& X,
+                                         const AbelianGroup& Y,
+                                         const MatrixQRefList& to_X_ref,
+                                         const MatrixQRefList& from_X_ref,
+                                         const MatrixQRefList& to_Y_ref,
+                                         const MatrixQRefList& from_Y_ref,
+                                         const MapRequest kernel_request =
+                                             MapRequest::All,
+                                         const MapRequest cokernel_request =
+                                             MapRequest::All);
+
+KernelAndCokernel compute_kernel_cokernel(const std::size_t p,
+                                         const SparseMatrixQ& f,
+                                         const AbelianGroup& X,
+                                         const AbelianGroup& Y,
+                                         const MatrixQRefList& to_X_ref,
+                                         const MatrixQRefList& from_X_ref,
+                                         const MatrixQRefList& to_Y_ref,
+                                         const MatrixQRefList& from_Y_ref,
+                                         const MapRequest kernel_request =
+                                             MapRequest::All,
+                                         const MapRequest cokernel_request =
+                                             MapRequest::All);
 
+// Image of f: X -> Y, with the projection from X in maps_to and the inclusion
+// into Y in maps_from. Needs no identity transforms: the free rows of f are
+// reduced first if both X and Y have a free part, and the rest of the image,
+// which lies in the torsion of Y, takes one more reduction.
 GroupWithMorphisms compute_image(const std::size_t p, const MatrixQ& f,
-                                    const AbelianGroup& X,
-                                    const AbelianGroup& Y);
+                                 const AbelianGroup& X, const AbelianGroup& Y,
+                                 const MapRequest request = MapRequest::All);
 
 bool morphism_equal(std::size_t p, const MatrixQ& f, const MatrixQ& g, const AbelianGroup& Y);
 bool morphism_zero(std::size_t p, const MatrixQ& f, const AbelianGroup& Y);
@@ -2,10 +2,16 @@
 
 #include "p_local.h"
 
+#include "counters.h"
+
 std::size_t p_val_z(const std::size_t p, const mpz_class& x)
 {
   if (x == 0) throw std::logic_error("p_valuation: x=0");
 
+  // The 2-adic valuation is the number of trailing zero bits, also in the
+  // two's complement GMP emulates for negative numbers.
+  if (p == 2) return mpz_scan1(x.get_mpz_t(), 0);
+
   std::size_t val = 0;
   mpz_class remainder = x;
 
@@ -19,6 +25,8 @@ std::size_t p_val_z(const std::size_t p, const mpz_class& x)
 
 long p_val_q(const std::size_t p, const mpq_class& x)
 {
+  AKSS_COUNT(PValQ);
+
   std::size_t num_valuation = p_val_z(p, x.get_num());
 
   if (num_valuation > 0)
@@ -27,6 +35,48 @@ long p_val_q(const std::size_t p, const mpq_class& x)
     return -static_cast<long>(p_val_z(p, x.get_den()));
 }
 
+long p_val_q(const std::size_t p, const mpz_class& x)
+{
+  AKSS_COUNT(PValQ);
+
+  return static_cast<long>(p_val_z(p, x));
+}
+
+bool residue_mod_p(const std::size_t p, const mpz_class& x,
+                   std::uint32_t& residue)
+{
+  residue = static_cast<std::uint32_t>(mpz_fdiv_ui(x.get_mpz_t(), p));
+  return true;
+}
+
+bool residue_mod_p(const std::size_t p, const mpq_class& x,
+                   std::uint32_t& residue)
+{
+  if (p == 2) {
+    if (mpz_even_p(x.get_den_mpz_t())) return false;
+    residue = mpz_odd_p(x.get_num_mpz_t()) ? 1 : 0;
+    return true;
+  }
+
+  const std::uint64_t den = mpz_fdiv_ui(x.get_den_mpz_t(), p);
+  if (den == 0) return false;
+
+  std::uint64_t num = mpz_fdiv_ui(x.get_num_mpz_t(), p);
+  if (den != 1) {
+    // den^(p - 2) is the inverse of den by Fermat's little theorem.
+    std::uint64_t inverse = 1;
+    std::uint64_t base = den;
+    for (std::size_t exp = p - 2; exp; exp >>= 1) {
+      if (exp & 1) inverse = inverse * base % p;
+      base = base * base % p;
+    }
+    num = num * inverse % p;
+  }
+
+  residue = static_cast<std::uint32_t>(num);
+  return true;
+}
+
 mpz_class p_pow_z(const std::size_t p, const std::size_t exp)
 {
   mpz_class pow;
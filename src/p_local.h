@@ -1,9 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
 #include <gmpxx.h>
 
 std::size_t p_val_z(const std::size_t p, const mpz_class& x);
 long p_val_q(const std::size_t p, const mpq_class& x);
+long p_val_q(const std::size_t p, const mpz_class& x);
+
+// Stores the image of x in F_p, p < 2^32, in residue. Returns false if x is not
+// p-integral.
+bool residue_mod_p(const std::size_t p, const mpq_class& x,
+                   std::uint32_t& residue);
+bool residue_mod_p(const std::size_t p, const mpz_class& x,
+                   std::uint32_t& residue);
 
 mpz_class p_pow_z(const std::size_t p, const std::size_t exp);
 mpq_class p_pow_q(const std::size_t p, const long exp);
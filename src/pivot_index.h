@@ -0,0 +1,123 @@
+#pragma once
+
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "sparse_matrix.h"
+
+// Entries of a matrix bucketed by p-adic valuation, used to find Smith pivots
+// without rescanning the matrix at every step.
+//
+// Only the trailing block of rows and columns >= the current diagonal block
+// size is indexed. Callers report every entry they change through
+// update_row/update_col; stale bucket entries are skipped lazily and dropped
+// when the buckets grow too large.
+template <typename T>
+class PivotIndex
+{
+ public:
+  PivotIndex(const std::size_t p, const Matrix<T>& f,
+             const std::size_t diagonal_block_size = 0);
+
+  void update_row(const Matrix<T>& f, const std::size_t i,
+                  const std::size_t j_begin);
+
+  // update_row split into two halves: read_row recomputes the valuations and
+  // may run concurrently for distinct rows, index_row files them into the
+  // buckets.
+  void read_row(const Matrix<T>& f, const std::size_t i,
+                const std::size_t j_begin);
+  void index_row(const std::size_t i, const std::size_t j_begin);
+
+  void update_col(const Matrix<T>& f, const std::size_t j,
+                  const std::size_t i_begin);
+
+  // Finds an entry of minimal valuation among the rows and columns >=
+  // diagonal_block_size. Returns false if all of these entries are zero.
+  bool find_min(const std::size_t diagonal_block_size, std::size_t& i,
+                std::size_t& j, long& valuation);
+
+ private:
+  void read(const std::size_t i, const std::size_t j, const T& value);
+  void index(const std::size_t i, const std::size_t j);
+  void rebuild(const std::size_t diagonal_block_size);
+
+  const std::size_t p_;
+  const std::size_t height_;
+  const std::size_t width_;
+
+  // Valuation of every entry, -1 for zero entries.
+  std::vector<long> valuations_;
+  std::vector<std::vector<std::size_t>> buckets_;
+  std::size_t bucket_entries_;
+};
+
+// Rows of a sparse matrix bucketed by the minimal p-adic valuation of their
+// entries, used to find the pivots of the sparse Smith reduction without
+// scanning all rows. Every bucket is a heap of rows keyed by their Markowitz
+// count: the least (r - 1)(c - 1) over the entries of minimal valuation in the
+// row, where r and c are the numbers of entries in its row and column.
+//
+// A key is computed when its row changes and raised when the row reaches the
+// top of its heap with a higher count, as its columns gained entries. Columns
+// losing entries do not lower the keys of their other rows, which would cost
+// as much as the elimination itself; the pivots found differ little from
+// those of a full search. Callers report every row they change through
+// update_row and the swaps they make through swap_rows/swap_cols.
+template <typename T>
+class SparsePivotIndex
+{
+ public:
+  SparsePivotIndex(const std::size_t p, const SparseMatrix<T>& f);
+
+  void update_row(const SparseMatrix<T>& f, const std::size_t i);
+
+  // Called after f.row_swap(i1, i2).
+  void swap_rows(const SparseMatrix<T>& f, const std::size_t i1,
+                 const std::size_t i2);
+
+  // Called after f.col_swap(j1, j2). Rows < i_begin are left as they are.
+  void swap_cols(const SparseMatrix<T>& f, const std::size_t j1,
+                 const std::size_t j2, const std::size_t i_begin);
+
+  // Among the entries of minimal valuation in the rows >= diagonal_block_size,
+  // finds one of least Markowitz count as far as the keys tell, preferring
+  // lower rows and then lower columns. Returns false if these rows are zero.
+  bool find_min(const SparseMatrix<T>& f,
+                const std::size_t diagonal_block_size, std::size_t& i,
+                std::size_t& j, long& valuation);
+
+ private:
+  struct Candidate {
+    std::size_t cost;
+    std::size_t row;
+    // Entries pushed before the latest indexing of their row are stale.
+    std::size_t stamp;
+
+    bool operator>(const Candidate& other) const
+    {
+      return cost != other.cost ? cost > other.cost : row > other.row;
+    }
+  };
+  typedef std::priority_queue<Candidate, std::vector<Candidate>,
+                              std::greater<Candidate>>
+      Bucket;
+
+  void index(const SparseMatrix<T>& f, const std::size_t i);
+  std::size_t cost(const SparseMatrix<T>& f, const std::size_t i,
+                   std::size_t& j) const;
+
+  const std::size_t p_;
+
+  // Minimal valuation of every row, -1 for zero rows, and the columns
+  // attaining it.
+  std::vector<long> row_min_;
+  std::vector<std::vector<std::size_t>> row_min_cols_;
+  std::vector<std::size_t> stamps_;
+  std::vector<Bucket> buckets_;
+};
+
+#include "pivot_index_impl.h"
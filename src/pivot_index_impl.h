@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <exception>
+
+#include "p_local.h"
+
+template <typename T>
+PivotIndex<T>::PivotIndex(const std::size_t p, const Matrix<T>& f,
+                          const std::size_t diagonal_block_size)
+    : p_(p),
+      height_(f.height()),
+      width_(f.width()),
+      valuations_(height_ * width_, -1),
+      bucket_entries_(0)
+{
+  for (std::size_t i = diagonal_block_size; i < height_; ++i) {
+    update_row(f, i, diagonal_block_size);
+  }
+}
+
+template <typename T>
+void PivotIndex<T>::update_row(const Matrix<T>& f, const std::size_t i,
+                               const std::size_t j_begin)
+{
+  read_row(f, i, j_begin);
+  index_row(i, j_begin);
+}
+
+template <typename T>
+void PivotIndex<T>::read_row(const Matrix<T>& f, const std::size_t i,
+                             const std::size_t j_begin)
+{
+  const MatrixRowView<T> row = f.row(i);
+  for (std::size_t j = j_begin; j < width_; ++j) {
+    read(i, j, row[j]);
+  }
+}
+
+template <typename T>
+void PivotIndex<T>::index_row(const std::size_t i, const std::size_t j_begin)
+{
+  for (std::size_t j = j_begin; j < width_; ++j) {
+    index(i, j);
+  }
+}
+
+template <typename T>
+void PivotIndex<T>::update_col(const Matrix<T>& f, const std::size_t j,
+                               const std::size_t i_begin)
+{
+  const MatrixColumnView<T> col = f.col(j);
+  for (std::size_t i = i_begin; i < height_; ++i) {
+    read(i, j, col[i]);
+    index(i, j);
+  }
+}
+
+template <typename T>
+void PivotIndex<T>::read(const std::size_t i, const std::size_t j,
+                         const T& value)
+{
+  const std::size_t pos = i * width_ + j;
+
+  if (!value) {
+    valuations_[pos] = -1;
+    return;
+  }
+
+  const long valuation = p_val_q(p_, value);
+  if (valuation < 0)
+    throw std::logic_error(
+        "smith_reduce_p: matrix entry has negative valuation");
+
+  valuations_[pos] = valuation;
+}
+
+template <typename T>
+void PivotIndex<T>::index(const std::size_t i, const std::size_t j)
+{
+  const std::size_t pos = i * width_ + j;
+  const long valuation = valuations_[pos];
+  if (valuation < 0) return;
+
+  const std::size_t bucket = static_cast<std::size_t>(valuation);
+  if (bucket >= buckets_.size()) buckets_.resize(bucket + 1);
+  buckets_[bucket].push_back(pos);
+  ++bucket_entries_;
+}
+
+template <typename T>
+void PivotIndex<T>::rebuild(const std::size_t diagonal_block_size)
+{
+  for (std::vector<std::size_t>& bucket : buckets_) {
+    bucket.clear();
+  }
+  bucket_entries_ = 0;
+
+  for (std::size_t i = diagonal_block_size; i < height_; ++i) {
+    for (std::size_t j = diagonal_block_size; j < width_; ++j) {
+      const long valuation = valuations_[i * width_ + j];
+      if (valuation < 0) continue;
+
+      buckets_[static_cast<std::size_t>(valuation)].push_back(i * width_ + j);
+      ++bucket_entries_;
+    }
+  }
+}
+
+template <typename T>
+bool PivotIndex<T>::find_min(const std::size_t diagonal_block_size,
+                             std::size_t& i, std::size_t& j, long& valuation)
+{
+  if (bucket_entries_ > 2 * valuations_.size() + 64)
+    rebuild(diagonal_block_size);
+
+  for (std::size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+    std::vector<std::size_t>& entries = buckets_[bucket];
+
+    while (!entries.empty()) {
+      const std::size_t pos = entries.back();
+      i = pos / width_;
+      j = pos % width_;
+
+      if (i >= diagonal_block_size && j >= diagonal_block_size &&
+          valuations_[pos] == static_cast<long>(bucket)) {
+        valuation = valuations_[pos];
+        return true;
+      }
+
+      entries.pop_back();
+      --bucket_entries_;
+    }
+  }
+
+  return false;
+}
+
+template <typename T>
+SparsePivotIndex<T>::SparsePivotIndex(const std::size_t p,
+                                      const SparseMatrix<T>& f)
+    : p_(p),
+      row_min_(f.height(), -1),
+      row_min_cols_(f.height()),
+      stamps_(f.height(), 0)
+{
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    update_row(f, i);
+  }
+}
+
+template <typename T>
+void SparsePivotIndex<T>::update_row(const SparseMatrix<T>& f,
+                                     const std::size_t i)
+{
+  long& row_min = row_min_[i];
+  std::vector<std::size_t>& row_min_cols = row_min_cols_[i];
+  row_min = -1;
+  row_min_cols.clear();
+
+  for (const typename SparseMatrix<T>::Entry& entry : f.row(i)) {
+    const long valuation = p_val_q(p_, entry.value);
+    if (valuation < 0)
+      throw std::logic_error(
+          "smith_reduce_p: matrix entry has negative valuation");
+
+    if (row_min < 0 || valuation < row_min) {
+      row_min = valuation;
+      row_min_cols.clear();
+    }
+    if (valuation == row_min) row_min_cols.push_back(entry.col);
+  }
+
+  index(f, i);
+}
+
+template <typename T>
+void SparsePivotIndex<T>::swap_rows(const SparseMatrix<T>& f,
+                                    const std::size_t i1, const std::size_t i2)
+{
+  std::swap(row_min_[i1], row_min_[i2]);
+  std::swap(row_min_cols_[i1], row_min_cols_[i2]);
+  index(f, i1);
+  index(f, i2);
+}
+
+template <typename T>
+void SparsePivotIndex<T>::swap_cols(const SparseMatrix<T>& f,
+                                    const std::size_t j1, const std::size_t j2,
+                                    const std::size_t i_begin)
+{
+  // Only the rows with an entry in either column refer to them, and the swap
+  // changes neither valuations nor Markowitz counts.
+  std::vector<std::size_t> rows = f.col(j1);
+  rows.insert(rows.end(), f.col(j2).begin(), f.col(j2).end());
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  for (const std::size_t i : rows) {
+    if (i < i_begin) continue;
+
+    for (std::size_t& j : row_min_cols_[i]) {
+      if (j == j1)
+        j = j2;
+      else if (j == j2)
+        j = j1;
+    }
+  }
+}
+
+template <typename T>
+void SparsePivotIndex<T>::index(const SparseMatrix<T>& f, const std::size_t i)
+{
+  ++stamps_[i];
+  if (row_min_[i] < 0) return;
+
+  const std::size_t bucket = static_cast<std::size_t>(row_min_[i]);
+  if (bucket >= buckets_.size()) buckets_.resize(bucket + 1);
+
+  std::size_t j;
+  buckets_[bucket].push(Candidate{cost(f, i, j), i, stamps_[i]});
+}
+
+template <typename T>
+std::size_t SparsePivotIndex<T>::cost(const SparseMatrix<T>& f,
+                                      const std::size_t i,
+                                      std::size_t& j) const
+{
+  std::size_t min_cost = 0;
+  std::size_t min_col = 0;
+  bool found = false;
+  for (const std::size_t col : row_min_cols_[i]) {
+    const std::size_t cost = (f.row(i).size() - 1) * (f.col(col).size() - 1);
+    if (!found || cost < min_cost || (cost == min_cost && col < min_col)) {
+      min_cost = cost;
+      min_col = col;
+      found = true;
+    }
+  }
+
+  j = min_col;
+  return min_cost;
+}
+
+template <typename T>
+bool SparsePivotIndex<T>::find_min(const SparseMatrix<T>& f,
+                                   const std::size_t diagonal_block_size,
+                                   std::size_t& i, std::size_t& j,
+                                   long& valuation)
+{
+  for (std::size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+    Bucket& rows = buckets_[bucket];
+
+    while (!rows.empty()) {
+      Candidate candidate = rows.top();
+      rows.pop();
+      if (candidate.row < diagonal_block_size ||
+          candidate.stamp != stamps_[candidate.row])
+        continue;
+
+      // The columns of the row may have gained entries since it was indexed.
+      const std::size_t cost = this->cost(f, candidate.row, j);
+      if (cost > candidate.cost) {
+        candidate.cost = cost;
+        rows.push(candidate);
+        continue;
+      }
+
+      i = candidate.row;
+      valuation = static_cast<long>(bucket);
+      return true;
+    }
+  }
+
+  return false;
+}
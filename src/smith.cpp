@@ -0,0 +1,228 @@
+#include "smith.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+std::atomic<bool>& use_unit_pivots()
+{
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+std::atomic<bool>& use_fraction_free()
+{
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+// Divides the entries [j_begin, end) of row i of f by the part prime to p of
+// their gcd, and returns that part.
+mpz_class remove_unit_content(const std::size_t p, Matrix<mpz_class>& f,
+                              const std::size_t i, const std::size_t j_begin)
+{
+  mpz_class content;
+  for (std::size_t j = j_begin; j < f.width(); ++j) {
+    const mpz_class& x = f(i, j);
+    if (!sgn(x)) continue;
+    mpz_gcd(content.get_mpz_t(), content.get_mpz_t(), x.get_mpz_t());
+    if (content == 1) return content;
+  }
+  if (content == 0) return 1;
+
+  mpz_class p_z(static_cast<unsigned long>(p));
+  mpz_remove(content.get_mpz_t(), content.get_mpz_t(), p_z.get_mpz_t());
+  if (content == 1) return content;
+
+  for (std::size_t j = j_begin; j < f.width(); ++j) {
+    mpz_class& x = f(i, j);
+    if (sgn(x)) mpz_divexact(x.get_mpz_t(), x.get_mpz_t(), content.get_mpz_t());
+  }
+  return content;
+}
+
+// Elimination of smith_reduce_dense over the integers. Row i becomes
+// unit * row i - multiple * pivot row, where unit is the part of the pivot
+// prime to p and both factors are integers because the pivot has minimal
+// valuation. The pivot becomes the power of p it is divided by.
+class FractionFreeElimination
+{
+ public:
+  explicit FractionFreeElimination(const std::size_t p) : p_(p)
+  {
+  }
+
+  void start(const Matrix<mpz_class>& f, const std::size_t i_min,
+             const std::size_t j_min, const long min_valuation,
+             const std::size_t rows)
+  {
+    min_value_ = f(i_min, j_min);
+    pow_ = p_pow_z(p_, static_cast<std::size_t>(min_valuation));
+    mpz_divexact(unit_.get_mpz_t(), min_value_.get_mpz_t(), pow_.get_mpz_t());
+    multiples_.resize(rows);
+    contents_.resize(rows);
+  }
+
+  void eliminate(Matrix<mpz_class>& f, const std::size_t k,
+                 const std::size_t i, const std::size_t i_min,
+                 const std::size_t j_min,
+                 const std::size_t diagonal_block_size)
+  {
+    mpz_divexact(multiples_[k].get_mpz_t(), f(i, j_min).get_mpz_t(),
+                 pow_.get_mpz_t());
+
+    for (std::size_t j = diagonal_block_size; j < f.width(); ++j) {
+      mpz_class& x = f(i, j);
+      if (j == j_min) {
+        x = 0;
+        continue;
+      }
+      if (unit_ != 1) x *= unit_;
+      const mpz_class& y = f(i_min, j);
+      if (sgn(y))
+        mpz_submul(x.get_mpz_t(), multiples_[k].get_mpz_t(), y.get_mpz_t());
+    }
+    AKSS_COUNT(RowAdd);
+
+    contents_[k] = remove_unit_content(p_, f, i, diagonal_block_size);
+  }
+
+  void log_row(const std::size_t k, const std::size_t i,
+               const std::size_t i_min, TransformLog<mpq_class>& log_Y) const
+  {
+    if (unit_ != 1) log_Y.mul(i, 1 / mpq_class(unit_));
+    log_Y.add(i, i_min, multiples_[k]);
+    if (contents_[k] != 1) log_Y.mul(i, contents_[k]);
+  }
+
+  void column_lambda(const mpz_class& x, mpq_class& lambda) const
+  {
+    mpz_neg(lambda.get_num_mpz_t(), x.get_mpz_t());
+    lambda.get_den() = min_value_;
+    lambda.canonicalize();
+  }
+
+  void finish(Matrix<mpz_class>& f, const std::size_t diagonal_block_size,
+              TransformLog<mpq_class>& log_X) const
+  {
+    f(diagonal_block_size, diagonal_block_size) = pow_;
+    log_X.mul(diagonal_block_size, 1 / mpq_class(unit_));
+  }
+
+ private:
+  const std::size_t p_;
+  mpz_class min_value_;
+  mpz_class pow_;
+  mpz_class unit_;
+  std::vector<mpz_class> multiples_;
+  std::vector<mpz_class> contents_;
+};
+
+std::mutex& smith_threads_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::unique_ptr<ThreadPool>& smith_pool()
+{
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+}  // namespace
+
+void set_smith_threads(const std::size_t threads)
+{
+  std::lock_guard<std::mutex> lock(smith_threads_mutex());
+
+  if (threads <= 1)
+    smith_pool().reset();
+  else if (!smith_pool() || smith_pool()->size() != threads - 1)
+    smith_pool().reset(new ThreadPool(threads - 1));
+
+  // Kernels and cokernels compose the transforms with rational products.
+  set_matrix_threads(threads);
+}
+
+std::size_t smith_threads()
+{
+  std::lock_guard<std::mutex> lock(smith_threads_mutex());
+
+  return smith_pool() ? smith_pool()->size() + 1 : 1;
+}
+
+ThreadPool* smith_thread_pool()
+{
+  std::lock_guard<std::mutex> lock(smith_threads_mutex());
+
+  return smith_pool().get();
+}
+
+void set_smith_unit_pivots(const bool enabled)
+{
+  use_unit_pivots().store(enabled);
+}
+
+bool smith_unit_pivots()
+{
+  return use_unit_pivots().load();
+}
+
+void set_smith_fraction_free(const bool enabled)
+{
+  use_fraction_free().store(enabled);
+}
+
+bool smith_fraction_free()
+{
+  return use_fraction_free().load();
+}
+
+void smith_reduce_p(const std::size_t p, Matrix<mpz_class>& f,
+                    TransformLog<mpq_class>& log_X,
+                    TransformLog<mpq_class>& log_Y, SmithStats* stats)
+{
+  FractionFreeElimination elimination(p);
+  smith_reduce_dense(p, f, elimination, log_X, log_Y, stats);
+}
+
+bool smith_reduce_p_fraction_free(const std::size_t p, Matrix<mpq_class>& f,
+                                  TransformLog<mpq_class>& log_X,
+                                  TransformLog<mpq_class>& log_Y,
+                                  SmithStats* stats)
+{
+  std::vector<mpz_class> dens(f.height(), 1);
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      const mpz_class& den = f(i, j).get_den();
+      if (den != 1)
+        mpz_lcm(dens[i].get_mpz_t(), dens[i].get_mpz_t(), den.get_mpz_t());
+    }
+    if (mpz_divisible_ui_p(dens[i].get_mpz_t(), p)) return false;
+  }
+
+  Matrix<mpz_class> g(f.height(), f.width());
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      const mpq_class& x = f(i, j);
+      if (!sgn(x)) continue;
+      mpz_class& y = g(i, j);
+      mpz_divexact(y.get_mpz_t(), dens[i].get_mpz_t(), x.get_den_mpz_t());
+      y *= x.get_num();
+    }
+    if (dens[i] != 1) log_Y.mul(i, 1 / mpq_class(dens[i]));
+  }
+
+  smith_reduce_p(p, g, log_X, log_Y, stats);
+
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      f(i, j) = g(i, j);
+    }
+  }
+
+  return true;
+}
@@ -1,10 +1,88 @@
 #pragma once
 
 #include "matrix.h"
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+#include "transform_log.h"
+
+// Wall-clock time spent in the phases of smith_reduce_p, in seconds.
+struct SmithStats {
+  double pivot_seconds = 0;
+  double elimination_seconds = 0;
+  double transform_seconds = 0;
+  std::size_t pivots = 0;
+  std::size_t unit_pivots = 0;
+};
+
+// Number of threads used by smith_reduce_p, including the calling one. Row
+// eliminations of the dense reduction and transform updates are split over
+// them; the result does not depend on the number of threads. Also sets
+// set_matrix_threads for rational products. Must not be changed while a
+// reduction is running.
+void set_smith_threads(const std::size_t threads);
+std::size_t smith_threads();
+ThreadPool* smith_thread_pool();
+
+// Whether the dense smith_reduce_p first looks for pivots of valuation 0 in a
+// copy of f reduced mod p, where they are found with word arithmetic instead
+// of p-adic valuations. These pivots are then eliminated exactly before the
+// p-local reduction takes over on the remaining block. Enabled by default;
+// only used for p < 2^32 and matrices with p-integral entries.
+void set_smith_unit_pivots(const bool enabled);
+bool smith_unit_pivots();
+
+// Whether the dense smith_reduce_p on rational matrices scales the rows of f
+// to integers (by their common denominators, which are prime to p) and runs
+// the fraction-free reduction on them. Enabled by default.
+void set_smith_fraction_free(const bool enabled);
+bool smith_fraction_free();
+
+// The rational reduction in fraction-free mode. Returns false without
+// touching any argument if f is not p-integral.
+bool smith_reduce_p_fraction_free(const std::size_t p, Matrix<mpq_class>& f,
+                                  TransformLog<mpq_class>& log_X,
+                                  TransformLog<mpq_class>& log_Y,
+                                  SmithStats* stats);
+
+// The transforms only receive row operations (to_X, to_Y) or column operations
+// (from_X, from_Y), so the latter are best stored in ColMajor layout.
+template <typename T, typename LT, typename LF>
+void smith_reduce_p(const std::size_t p, Matrix<T>& f,
+                    MatrixRefList<T, LT>& to_X, MatrixRefList<T, LF>& from_X,
+                    MatrixRefList<T, LT>& to_Y, MatrixRefList<T, LF>& from_Y,
+                    SmithStats* stats = nullptr);
+
+// Reduces f without updating any transforms. The basis changes on the column
+// side (X) and the row side (Y) of f are recorded in log_X and log_Y, to be
+// replayed later on whichever transforms turn out to be needed.
+template <typename T>
+void smith_reduce_p(const std::size_t p, Matrix<T>& f, TransformLog<T>& log_X,
+                    TransformLog<T>& log_Y, SmithStats* stats = nullptr);
+
+// Fraction-free variant for integer matrices. A row is eliminated by scaling
+// it with the p-prime part of the pivot and subtracting a multiple of the
+// pivot row, and its entries are then divided by the p-prime part of their
+// gcd. All scalings are by integers prime to p, i.e. units of Z_(p), so f
+// stays integral and its entries stay small; the transforms are rational.
+void smith_reduce_p(const std::size_t p, Matrix<mpz_class>& f,
+                    TransformLog<mpq_class>& log_X,
+                    TransformLog<mpq_class>& log_Y,
+                    SmithStats* stats = nullptr);
+
+// Sparse variant: among the entries of minimal valuation, a pivot of small
+// Markowitz count (r - 1)(c - 1) is chosen to limit fill-in, where r and c are
+// the numbers of nonzero entries in its row and column. The rows are kept in a
+// SparsePivotIndex, so a pivot step takes time in the entries it changes rather
+// than in the height of f.
+template <typename T, typename LT, typename LF>
+void smith_reduce_p(const std::size_t p, SparseMatrix<T>& f,
+                    MatrixRefList<T, LT>& to_X, MatrixRefList<T, LF>& from_X,
+                    MatrixRefList<T, LT>& to_Y, MatrixRefList<T, LF>& from_Y,
+                    SmithStats* stats = nullptr);
 
 template <typename T>
-void smith_reduce_p(const std::size_t p, Matrix<T>& f, MatrixRefList<T>& to_X,
-                    MatrixRefList<T>& from_X, MatrixRefList<T>& to_Y,
-                    MatrixRefList<T>& from_Y);
+void smith_reduce_p(const std::size_t p, SparseMatrix<T>& f,
+                    TransformLog<T>& log_X, TransformLog<T>& log_Y,
+                    SmithStats* stats = nullptr);
 
 #include "smith_impl.h"
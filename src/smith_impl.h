@@ -1,62 +1,365 @@
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <iostream>
+#include <memory>
+#include <utility>
 
 #include "p_local.h"
+#include "pivot_index.h"
+#include "unit_pivots.h"
 
+// Number of matrix entries a worker should update at least per chunk of rows.
+const std::size_t SMITH_PARALLEL_GRAIN_ENTRIES = 1 << 12;
+
+// The leading pivots of valuation 0 of the dense reduction, found mod p. Empty
+// if f has an entry that is not p-integral or p does not fit into 32 bits.
+template <typename T>
+std::vector<std::pair<std::size_t, std::size_t>> unit_pivots_mod_p(
+    const std::size_t p, const Matrix<T>& f)
+{
+  std::vector<std::pair<std::size_t, std::size_t>> none;
+  if (p >> 32) return none;
+
+  std::vector<std::uint32_t> residues(f.height() * f.width());
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    const MatrixRowView<T> row = f.row(i);
+    for (std::size_t j = 0; j < f.width(); ++j) {
+      if (!residue_mod_p(p, row[j], residues[i * f.width() + j])) return none;
+    }
+  }
+
+  return find_unit_pivots(p, f.height(), f.width(), residues);
+}
+
+template <typename T, typename LT, typename LF>
+void smith_reduce_p(const std::size_t p, Matrix<T>& f,
+                    MatrixRefList<T, LT>& to_X, MatrixRefList<T, LF>& from_X,
+                    MatrixRefList<T, LT>& to_Y, MatrixRefList<T, LF>& from_Y,
+                    SmithStats* stats)
+{
+  AKSS_COUNTER_SCOPE("smith_reduce_p");
+
+  TransformLog<T> log_X(!to_X.empty() || !from_X.empty());
+  TransformLog<T> log_Y(!to_Y.empty() || !from_Y.empty());
+  smith_reduce_p(p, f, log_X, log_Y, stats);
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start;
+  if (stats) start = Clock::now();
+
+  log_X.apply(to_X, from_X, smith_thread_pool());
+  log_Y.apply(to_Y, from_Y, smith_thread_pool());
+
+  if (stats) {
+    stats->transform_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+}
+
+// Only rational matrices have a fraction-free mode.
 template <typename T>
-void smith_reduce_p(const std::size_t p, Matrix<T>& f, MatrixRefList<T>& to_X,
-                    MatrixRefList<T>& from_X, MatrixRefList<T>& to_Y,
-                    MatrixRefList<T>& from_Y)
+bool smith_reduce_p_fraction_free(const std::size_t, Matrix<T>&,
+                                  TransformLog<T>&, TransformLog<T>&,
+                                  SmithStats*)
 {
-  from_X.emplace_back(f);
-  to_Y.emplace_back(f);
+  return false;
+}
+
+// Pivot loop of the dense reductions. The reductions differ only in how the
+// rows below a pivot are eliminated and how the pivot is normalized, which
+// Elimination provides:
+// - start(f, i_min, j_min, min_valuation, rows) before the rows of a pivot
+//   are eliminated,
+// - eliminate(f, k, i, i_min, j_min, diagonal_block_size) for the k-th of
+//   these rows, on any thread,
+// - log_row(k, i, i_min, log_Y) for the same row afterwards, in order of k,
+// - column_lambda(x, lambda), which sets lambda to the multiplier logged for
+//   the column operation that clears the entry x of the pivot row,
+// - finish(f, diagonal_block_size, log_X) once the pivot is on the diagonal.
+template <typename T, typename U, typename Elimination>
+void smith_reduce_dense(const std::size_t p, Matrix<T>& f,
+                        Elimination& elimination, TransformLog<U>& log_X,
+                        TransformLog<U>& log_Y, SmithStats* stats)
+{
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start;
+  if (stats) start = Clock::now();
+
+  // The pivot search reads whole rows and columns, and rows are eliminated by
+  // several threads at once.
+  f.expand();
+  f.detach();
+
+  // Pivots of valuation 0 come first anyway, so they are taken from the
+  // reduction mod p as long as there are any, and the pivot index is only
+  // built for the block that remains.
+  std::vector<std::pair<std::size_t, std::size_t>> unit_pivots;
+  if (smith_unit_pivots()) unit_pivots = unit_pivots_mod_p(p, f);
+  if (stats) stats->unit_pivots += unit_pivots.size();
+  std::unique_ptr<PivotIndex<T>> pivots;
 
-  mpq_class lambda;
+  ThreadPool* pool = smith_thread_pool();
+  ThreadContext<T> context;
+  const std::size_t grain = SMITH_PARALLEL_GRAIN_ENTRIES / (f.width() + 1) + 1;
+  std::vector<std::size_t> rows;
+
+  U lambda;
   for (std::size_t diagonal_block_size = 0;
        diagonal_block_size < std::min(f.height(), f.width());
        ++diagonal_block_size) {
     std::size_t i_min = 0;
     std::size_t j_min = 0;
-    T min_value;
     long min_valuation = 0;
 
+    if (stats) {
+      Clock::time_point now = Clock::now();
+      stats->elimination_seconds +=
+          std::chrono::duration<double>(now - start).count();
+      start = now;
+    }
+
+    bool found = true;
+    if (diagonal_block_size < unit_pivots.size()) {
+      i_min = unit_pivots[diagonal_block_size].first;
+      j_min = unit_pivots[diagonal_block_size].second;
+    } else {
+      if (!pivots) pivots.reset(new PivotIndex<T>(p, f, diagonal_block_size));
+      found =
+          pivots->find_min(diagonal_block_size, i_min, j_min, min_valuation);
+    }
+
+    if (stats) {
+      Clock::time_point now = Clock::now();
+      stats->pivot_seconds +=
+          std::chrono::duration<double>(now - start).count();
+      start = now;
+    }
+
+    if (!found) break;
+    if (stats) ++stats->pivots;
+    AKSS_COUNT(PivotSteps);
+
+    rows.clear();
     for (std::size_t i = diagonal_block_size; i < f.height(); ++i) {
-      for (std::size_t j = diagonal_block_size; j < f.width(); ++j) {
-        if (f(i, j)) {
-          if (!min_value || p_val_q(p, f(i, j)) < min_valuation) {
-            i_min = i;
-            j_min = j;
-            min_value = f(i, j);
-            min_valuation = p_val_q(p, min_value);
-          }
-        }
+      if (i != i_min && f(i, j_min)) rows.push_back(i);
+    }
+    elimination.start(f, i_min, j_min, min_valuation, rows.size());
+
+    // The rows are eliminated independently of each other, and only the
+    // bookkeeping happens in a fixed order afterwards.
+    parallel_for(pool, 0, rows.size(), grain,
+                 [&](std::size_t begin, std::size_t end) {
+                   typename ThreadContext<T>::Scope scope(context);
+                   for (std::size_t k = begin; k < end; ++k) {
+                     elimination.eliminate(f, k, rows[k], i_min, j_min,
+                                           diagonal_block_size);
+                     if (pivots)
+                       pivots->read_row(f, rows[k], diagonal_block_size);
+                   }
+                 });
+
+    for (std::size_t k = 0; k < rows.size(); ++k) {
+      elimination.log_row(k, rows[k], i_min, log_Y);
+      if (pivots) pivots->index_row(rows[k], diagonal_block_size);
+    }
+
+    // The column of the pivot is zero apart from the pivot now, so the column
+    // operations only clear the row of the pivot, which leaves the trailing
+    // block.
+    for (std::size_t j = diagonal_block_size; j < f.width(); ++j) {
+      if (j == j_min || !f(i_min, j)) continue;
+      if (log_X.recording()) {
+        elimination.column_lambda(f(i_min, j), lambda);
+        log_X.add(j_min, j, lambda);
       }
+      f(i_min, j) = 0;
+      AKSS_COUNT(ColAdd);
     }
 
-    if (!min_value) break;
-    if (min_valuation < 0)
-      throw std::logic_error(
-          "smith_reduce_p: matrix entry has negative valuation");
+    f.row_swap(i_min, diagonal_block_size);
+    log_Y.swap(i_min, diagonal_block_size);
+    f.col_swap(j_min, diagonal_block_size);
+    log_X.swap(j_min, diagonal_block_size);
 
-    for (std::size_t i = diagonal_block_size; i < f.height(); ++i) {
+    if (pivots && i_min != diagonal_block_size)
+      pivots->update_row(f, i_min, diagonal_block_size + 1);
+    if (pivots && j_min != diagonal_block_size)
+      pivots->update_col(f, j_min, diagonal_block_size + 1);
+
+    elimination.finish(f, diagonal_block_size, log_X);
+  }
+
+  if (stats) {
+    stats->elimination_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+}
+
+// Elimination of smith_reduce_dense over a field of fractions: multiples of
+// the pivot row are subtracted, and the pivot is divided by its unit part.
+template <typename T>
+class DivisionElimination
+{
+ public:
+  explicit DivisionElimination(const std::size_t p) : p_(p)
+  {
+  }
+
+  void start(const Matrix<T>& f, const std::size_t i_min,
+             const std::size_t j_min, const long min_valuation,
+             const std::size_t rows)
+  {
+    min_value_ = f(i_min, j_min);
+    min_valuation_ = min_valuation;
+    lambdas_.resize(rows);
+  }
+
+  void eliminate(Matrix<T>& f, const std::size_t k, const std::size_t i,
+                 const std::size_t i_min, const std::size_t j_min,
+                 const std::size_t)
+  {
+    lambdas_[k] = f(i, j_min) / min_value_;
+    f.row_add(i_min, i, -lambdas_[k]);
+  }
+
+  void log_row(const std::size_t k, const std::size_t i,
+               const std::size_t i_min, TransformLog<T>& log_Y) const
+  {
+    log_Y.add(i, i_min, lambdas_[k]);
+  }
+
+  void column_lambda(const T& x, T& lambda) const
+  {
+    lambda = -x / min_value_;
+  }
+
+  void finish(Matrix<T>& f, const std::size_t diagonal_block_size,
+              TransformLog<T>& log_X) const
+  {
+    const T lambda =
+        T(p_pow_z(p_, static_cast<std::size_t>(min_valuation_))) / min_value_;
+    f(diagonal_block_size, diagonal_block_size) *= lambda;
+    log_X.mul(diagonal_block_size, lambda);
+  }
+
+ private:
+  const std::size_t p_;
+  T min_value_;
+  long min_valuation_ = 0;
+  std::vector<T> lambdas_;
+};
+
+template <typename T>
+void smith_reduce_p(const std::size_t p, Matrix<T>& f, TransformLog<T>& log_X,
+                    TransformLog<T>& log_Y, SmithStats* stats)
+{
+  if (smith_fraction_free() &&
+      smith_reduce_p_fraction_free(p, f, log_X, log_Y, stats))
+    return;
+
+  DivisionElimination<T> elimination(p);
+  smith_reduce_dense(p, f, elimination, log_X, log_Y, stats);
+}
+
+template <typename T, typename LT, typename LF>
+void smith_reduce_p(const std::size_t p, SparseMatrix<T>& f,
+                    MatrixRefList<T, LT>& to_X, MatrixRefList<T, LF>& from_X,
+                    MatrixRefList<T, LT>& to_Y, MatrixRefList<T, LF>& from_Y,
+                    SmithStats* stats)
+{
+  AKSS_COUNTER_SCOPE("smith_reduce_p (sparse)");
+
+  TransformLog<T> log_X(!to_X.empty() || !from_X.empty());
+  TransformLog<T> log_Y(!to_Y.empty() || !from_Y.empty());
+  smith_reduce_p(p, f, log_X, log_Y, stats);
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start;
+  if (stats) start = Clock::now();
+
+  log_X.apply(to_X, from_X, smith_thread_pool());
+  log_Y.apply(to_Y, from_Y, smith_thread_pool());
+
+  if (stats) {
+    stats->transform_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+}
+
+template <typename T>
+void smith_reduce_p(const std::size_t p, SparseMatrix<T>& f,
+                    TransformLog<T>& log_X, TransformLog<T>& log_Y,
+                    SmithStats* stats)
+{
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start;
+  if (stats) start = Clock::now();
+
+  SparsePivotIndex<T> index(p, f);
+
+  T lambda;
+  for (std::size_t diagonal_block_size = 0;
+       diagonal_block_size < std::min(f.height(), f.width());
+       ++diagonal_block_size) {
+    if (stats) {
+      Clock::time_point now = Clock::now();
+      stats->elimination_seconds +=
+          std::chrono::duration<double>(now - start).count();
+      start = now;
+    }
+
+    std::size_t i_min;
+    std::size_t j_min;
+    long min_valuation;
+    const bool found =
+        index.find_min(f, diagonal_block_size, i_min, j_min, min_valuation);
+
+    if (stats) {
+      Clock::time_point now = Clock::now();
+      stats->pivot_seconds +=
+          std::chrono::duration<double>(now - start).count();
+      start = now;
+    }
+
+    if (!found) break;
+    if (stats) ++stats->pivots;
+    AKSS_COUNT(PivotSteps);
+
+    const T min_value = f(i_min, j_min);
+
+    const std::vector<std::size_t> rows = f.col(j_min);
+    for (const std::size_t i : rows) {
       if (i == i_min) continue;
       lambda = f(i, j_min) / min_value;
-      basis_vectors_add(to_Y, from_Y, i, i_min, lambda);
+      f.row_add(i_min, i, -lambda);
+      log_Y.add(i, i_min, lambda);
+      index.update_row(f, i);
     }
 
-    for (std::size_t j = diagonal_block_size; j < f.width(); ++j) {
-      if (j == j_min) continue;
-      lambda = -f(i_min, j) / min_value;
-      basis_vectors_add(to_X, from_X, j_min, j, lambda);
+    const std::vector<typename SparseMatrix<T>::Entry> row = f.row(i_min);
+    for (const typename SparseMatrix<T>::Entry& entry : row) {
+      if (entry.col == j_min) continue;
+      lambda = -entry.value / min_value;
+      f.col_add(j_min, entry.col, lambda);
+      log_X.add(j_min, entry.col, lambda);
     }
 
-    basis_vectors_swap(to_Y, from_Y, i_min, diagonal_block_size);
-    basis_vectors_swap(to_X, from_X, j_min, diagonal_block_size);
+    f.row_swap(i_min, diagonal_block_size);
+    log_Y.swap(i_min, diagonal_block_size);
+    index.swap_rows(f, i_min, diagonal_block_size);
+    f.col_swap(j_min, diagonal_block_size);
+    log_X.swap(j_min, diagonal_block_size);
+    index.swap_cols(f, j_min, diagonal_block_size, diagonal_block_size + 1);
 
-    lambda = p_pow_z(p, static_cast<std::size_t>(min_valuation)) / min_value;
-    basis_vectors_mul(to_X, from_X, diagonal_block_size, lambda);
+    lambda =
+        T(p_pow_z(p, static_cast<std::size_t>(min_valuation))) / min_value;
+    f.col_mul(diagonal_block_size, lambda);
+    log_X.mul(diagonal_block_size, lambda);
   }
 
-  from_X.pop_back();
-  to_Y.pop_back();
+  if (stats) {
+    stats->elimination_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
 }
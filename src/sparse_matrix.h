@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "matrix.h"
+
+// Matrix storing only its nonzero entries: every row keeps its entries sorted
+// by column, and every column keeps the (unsorted) list of rows with a nonzero
+// entry in it. Elementary operations cost time proportional to the number of
+// nonzero entries they touch, and entries cancelling to zero are dropped.
+template <typename T>
+class SparseMatrix : public MatrixExpression<T, SparseMatrix<T>>
+{
+ public:
+  struct Entry {
+    std::size_t col;
+    T value;
+  };
+
+  SparseMatrix(const std::size_t height, const std::size_t width);
+
+  template <typename E>
+  explicit SparseMatrix(const MatrixExpression<T, E>& expr);
+
+  // Takes over rows whose entries are nonzero and sorted by distinct columns.
+  SparseMatrix(const std::size_t width, std::vector<std::vector<Entry>>&& rows);
+
+  SparseMatrix(const SparseMatrix<T>& other) = default;
+  SparseMatrix(SparseMatrix<T>&& other) = default;
+
+  inline std::size_t height() const
+  {
+    return rows_.size();
+  }
+
+  inline std::size_t width() const
+  {
+    return cols_.size();
+  }
+
+  T operator()(const std::size_t i, const std::size_t j) const;
+  void set(const std::size_t i, const std::size_t j, const T& value);
+
+  std::size_t nonzeros() const;
+
+  inline const std::vector<Entry>& row(const std::size_t i) const
+  {
+    return rows_[i];
+  }
+
+  inline const std::vector<std::size_t>& col(const std::size_t j) const
+  {
+    return cols_[j];
+  }
+
+  SparseMatrix<T>& row_add(const std::size_t i1, const std::size_t i2,
+                           const T& lambda);
+  SparseMatrix<T>& row_mul(const std::size_t i, const T& lambda);
+  SparseMatrix<T>& row_swap(const std::size_t i1, const std::size_t i2);
+
+  SparseMatrix<T>& col_add(const std::size_t j1, const std::size_t j2,
+                           const T& lambda);
+  SparseMatrix<T>& col_mul(const std::size_t j, const T& lambda);
+  SparseMatrix<T>& col_swap(const std::size_t j1, const std::size_t j2);
+
+ private:
+  typename std::vector<Entry>::iterator find(const std::size_t i,
+                                             const std::size_t j);
+  void erase_from_col(const std::size_t j, const std::size_t i);
+
+  std::vector<std::vector<Entry>> rows_;
+  std::vector<std::vector<std::size_t>> cols_;
+};
+
+using SparseMatrixQ = SparseMatrix<mpq_class>;
+
+template <typename T>
+Matrix<T> operator*(const SparseMatrix<T>& g, const Matrix<T>& f);
+
+template <typename T>
+std::ostream& operator<<(std::ostream& stream, const SparseMatrix<T>& f);
+
+#include "sparse_matrix_impl.h"
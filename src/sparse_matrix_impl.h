@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <exception>
+#include <string>
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const std::size_t height, const std::size_t width)
+    : rows_(height), cols_(width)
+{
+}
+
+template <typename T>
+template <typename E>
+SparseMatrix<T>::SparseMatrix(const MatrixExpression<T, E>& expr)
+    : rows_(expr.height()), cols_(expr.width())
+{
+  for (std::size_t i = 0; i < height(); ++i) {
+    for (std::size_t j = 0; j < width(); ++j) {
+      const T& value = expr(i, j);
+      if (!value) continue;
+
+      rows_[i].push_back(Entry{j, value});
+      cols_[j].push_back(i);
+    }
+  }
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const std::size_t width,
+                              std::vector<std::vector<Entry>>&& rows)
+    : rows_(std::move(rows)), cols_(width)
+{
+  for (std::size_t i = 0; i < height(); ++i) {
+    for (const Entry& entry : rows_[i]) {
+      cols_[entry.col].push_back(i);
+    }
+  }
+}
+
+template <typename T>
+typename std::vector<typename SparseMatrix<T>::Entry>::iterator
+SparseMatrix<T>::find(const std::size_t i, const std::size_t j)
+{
+  return std::lower_bound(
+      rows_[i].begin(), rows_[i].end(), j,
+      [](const Entry& entry, const std::size_t col) { return entry.col < col; });
+}
+
+template <typename T>
+void SparseMatrix<T>::erase_from_col(const std::size_t j, const std::size_t i)
+{
+  std::vector<std::size_t>& col = cols_[j];
+  std::vector<std::size_t>::iterator pos = std::find(col.begin(), col.end(), i);
+
+  *pos = col.back();
+  col.pop_back();
+}
+
+template <typename T>
+T SparseMatrix<T>::operator()(const std::size_t i, const std::size_t j) const
+{
+  typename std::vector<Entry>::const_iterator pos = std::lower_bound(
+      rows_[i].begin(), rows_[i].end(), j,
+      [](const Entry& entry, const std::size_t col) { return entry.col < col; });
+
+  if (pos != rows_[i].end() && pos->col == j) return pos->value;
+  return T();
+}
+
+template <typename T>
+void SparseMatrix<T>::set(const std::size_t i, const std::size_t j,
+                          const T& value)
+{
+  typename std::vector<Entry>::iterator pos = find(i, j);
+  const bool present = pos != rows_[i].end() && pos->col == j;
+
+  if (!value) {
+    if (present) {
+      rows_[i].erase(pos);
+      erase_from_col(j, i);
+    }
+  } else if (present) {
+    pos->value = value;
+  } else {
+    rows_[i].insert(pos, Entry{j, value});
+    cols_[j].push_back(i);
+  }
+}
+
+template <typename T>
+std::size_t SparseMatrix<T>::nonzeros() const
+{
+  std::size_t count = 0;
+
+  for (const std::vector<Entry>& row : rows_) {
+    count += row.size();
+  }
+
+  return count;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::row_add(const std::size_t i1,
+                                          const std::size_t i2,
+                                          const T& lambda)
+{
+  AKSS_COUNT(RowAdd);
+
+  if (!lambda) return *this;
+  if (i1 == i2) return row_mul(i1, 1 + lambda);
+
+  const std::vector<Entry>& src = rows_[i1];
+  const std::vector<Entry>& dst = rows_[i2];
+  std::vector<Entry> sum;
+  sum.reserve(src.size() + dst.size());
+
+  typename std::vector<Entry>::const_iterator s = src.begin();
+  typename std::vector<Entry>::const_iterator d = dst.begin();
+  while (s != src.end() || d != dst.end()) {
+    if (s == src.end() || (d != dst.end() && d->col < s->col)) {
+      sum.push_back(*d++);
+    } else if (d == dst.end() || s->col < d->col) {
+      T value = lambda * s->value;
+      if (value) {
+        sum.push_back(Entry{s->col, value});
+        cols_[s->col].push_back(i2);
+      }
+      ++s;
+    } else {
+      T value = d->value + lambda * s->value;
+      if (value)
+        sum.push_back(Entry{d->col, value});
+      else
+        erase_from_col(d->col, i2);
+      ++s;
+      ++d;
+    }
+  }
+
+  rows_[i2] = std::move(sum);
+  return *this;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::row_mul(const std::size_t i, const T& lambda)
+{
+  AKSS_COUNT(RowMul);
+
+  if (!lambda) {
+    for (const Entry& entry : rows_[i]) {
+      erase_from_col(entry.col, i);
+    }
+    rows_[i].clear();
+    return *this;
+  }
+
+  for (Entry& entry : rows_[i]) {
+    entry.value *= lambda;
+  }
+  return *this;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::row_swap(const std::size_t i1,
+                                           const std::size_t i2)
+{
+  AKSS_COUNT(RowSwap);
+
+  if (i1 == i2) return *this;
+
+  const std::size_t moved = static_cast<std::size_t>(-1);
+  for (const Entry& entry : rows_[i1]) {
+    std::vector<std::size_t>& col = cols_[entry.col];
+    *std::find(col.begin(), col.end(), i1) = moved;
+  }
+  for (const Entry& entry : rows_[i2]) {
+    std::vector<std::size_t>& col = cols_[entry.col];
+    *std::find(col.begin(), col.end(), i2) = i1;
+  }
+  for (const Entry& entry : rows_[i1]) {
+    std::vector<std::size_t>& col = cols_[entry.col];
+    *std::find(col.begin(), col.end(), moved) = i2;
+  }
+
+  std::swap(rows_[i1], rows_[i2]);
+  return *this;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::col_add(const std::size_t j1,
+                                          const std::size_t j2,
+                                          const T& lambda)
+{
+  AKSS_COUNT(ColAdd);
+
+  if (!lambda) return *this;
+  if (j1 == j2) return col_mul(j1, 1 + lambda);
+
+  const std::vector<std::size_t> rows = cols_[j1];
+  for (const std::size_t i : rows) {
+    T value = lambda * find(i, j1)->value;
+
+    typename std::vector<Entry>::iterator pos = find(i, j2);
+    if (pos != rows_[i].end() && pos->col == j2) {
+      pos->value += value;
+      if (!pos->value) {
+        rows_[i].erase(pos);
+        erase_from_col(j2, i);
+      }
+    } else if (value) {
+      rows_[i].insert(pos, Entry{j2, value});
+      cols_[j2].push_back(i);
+    }
+  }
+  return *this;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::col_mul(const std::size_t j, const T& lambda)
+{
+  AKSS_COUNT(ColMul);
+
+  for (const std::size_t i : cols_[j]) {
+    typename std::vector<Entry>::iterator pos = find(i, j);
+    if (lambda)
+      pos->value *= lambda;
+    else
+      rows_[i].erase(pos);
+  }
+
+  if (!lambda) cols_[j].clear();
+  return *this;
+}
+
+template <typename T>
+SparseMatrix<T>& SparseMatrix<T>::col_swap(const std::size_t j1,
+                                           const std::size_t j2)
+{
+  AKSS_COUNT(ColSwap);
+
+  if (j1 == j2) return *this;
+
+  std::vector<std::size_t> rows = cols_[j1];
+  rows.insert(rows.end(), cols_[j2].begin(), cols_[j2].end());
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  for (const std::size_t i : rows) {
+    for (Entry& entry : rows_[i]) {
+      if (entry.col == j1)
+        entry.col = j2;
+      else if (entry.col == j2)
+        entry.col = j1;
+    }
+    std::sort(rows_[i].begin(), rows_[i].end(),
+              [](const Entry& a, const Entry& b) { return a.col < b.col; });
+  }
+
+  std::swap(cols_[j1], cols_[j2]);
+  return *this;
+}
+
+template <typename T>
+Matrix<T> operator*(const SparseMatrix<T>& g, const Matrix<T>& f)
+{
+  if (g.width() != f.height())
+    throw std::logic_error("SparseMatrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(g.width()) + " != " +
+                           std::to_string(f.height()));
+
+  Matrix<T> gf(g.height(), f.width());
+  for (std::size_t i = 0; i < g.height(); ++i) {
+    for (const typename SparseMatrix<T>::Entry& entry : g.row(i)) {
+      for (std::size_t j = 0; j < f.width(); ++j) {
+        gf(i, j) += entry.value * f(entry.col, j);
+      }
+    }
+  }
+
+  return gf;
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& stream, const SparseMatrix<T>& f)
+{
+  stream << "SparseMatrix (" << f.height() << "x" << f.width() << ", "
+         << f.nonzeros() << " nonzero)\n";
+
+  for (std::size_t i = 0; i < f.height(); ++i) {
+    for (const typename SparseMatrix<T>::Entry& entry : f.row(i)) {
+      stream << "(" << i << ", " << entry.col << ") " << entry.value << "\n";
+    }
+  }
+
+  return stream;
+}
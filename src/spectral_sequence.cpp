@@ -1,7 +1,11 @@
 #include "spectral_sequence.h"
 
+#include <algorithm>
+#include <iterator>
 #include <tuple>
 
+#include "smith.h"
+
 TrigradedIndex::TrigradedIndex(const int p, const int q, const int s)
     : p_(p), q_(q), s_(s)
 {
@@ -59,7 +63,7 @@ const AbelianGroup& GroupSequence::get_group(const std::size_t index)
     throw std::logic_error("GroupSequence::get_group: Index is not yet set");
   }
   std::map<std::size_t, std::tuple<AbelianGroup, MatrixQ>>::iterator pos =
-      entries_.upper_bound(index);
+      std::prev(entries_.upper_bound(index));
 
   return (std::get<0>(pos->second));
 }
@@ -74,7 +78,7 @@ const MatrixQ& GroupSequence::get_matrix(const std::size_t index)
     throw std::logic_error("GroupSequence::get_matrix: Index is not yet set");
   }
   std::map<std::size_t, std::tuple<AbelianGroup, MatrixQ>>::iterator pos =
-      entries_.upper_bound(index);
+      std::prev(entries_.upper_bound(index));
 
   return (std::get<1>(pos->second));
 }
@@ -84,60 +88,194 @@ std::size_t GroupSequence::get_current()
   return current_;
 }
 
+std::size_t GroupSequence::get_index_min()
+{
+  return entries_.begin()->first;
+}
+
 void GroupSequence::inc()
 {
   ++current_;
 }
 
+SpectralSequence::SpectralSequence(const std::size_t prime) : prime_(prime)
+{
+}
+
+void SpectralSequence::set_group(TrigradedIndex pqs, std::size_t r_min,
+                                 const AbelianGroup& grp)
+{
+  if (kernels_.count(pqs)) {
+    throw std::logic_error("SpectralSequence::set_group: Group is already set.");
+  }
+
+  kernels_.emplace(pqs, GroupSequence(r_min, grp));
+  cokernels_.emplace(pqs, GroupSequence(r_min, grp));
+}
+
 void SpectralSequence::set_diff(TrigradedIndex pqs, std::size_t r,
                                 MatrixQ matrix)
 {
-  TrigradedIndex diff_offset(-r, r - 1, 1);  // is that cast okay?
+  std::pair<GroupSequence*, GroupSequence*> sequences = diff_sequences(pqs, r);
+
+  update_sequences(*sequences.first, *sequences.second, r, matrix);
+  differentials_[pqs].push_back(matrix);
+}
+
+void SpectralSequence::set_diffs(std::size_t r, const DifferentialList& diffs)
+{
+  std::vector<std::pair<GroupSequence*, GroupSequence*>> sequences;
+  MatrixQList matrices;
+  for (const auto& diff : diffs) {
+    sequences.push_back(diff_sequences(diff.first, r));
+    matrices.push_back(diff.second);
+  }
+
+  // A differential has to wait for all earlier ones appending to one of its
+  // sequences, so it runs in the wave after the last of them.
+  std::map<const GroupSequence*, std::size_t> next_wave;
+  std::vector<std::vector<std::size_t>> waves;
+  for (std::size_t k = 0; k < diffs.size(); ++k) {
+    const std::size_t wave = std::max(next_wave[sequences[k].first],
+                                      next_wave[sequences[k].second]);
+    next_wave[sequences[k].first] = wave + 1;
+    next_wave[sequences[k].second] = wave + 1;
+
+    if (wave == waves.size()) waves.emplace_back();
+    waves[wave].push_back(k);
+  }
+
+  for (const std::vector<std::size_t>& wave : waves) {
+    parallel_for(smith_thread_pool(), 0, wave.size(), 1,
+                 [&](std::size_t begin, std::size_t end) {
+                   for (std::size_t w = begin; w < end; ++w) {
+                     const std::size_t k = wave[w];
+                     update_sequences(*sequences[k].first,
+                                      *sequences[k].second, r,
+                                      matrices[k]);
+                   }
+                 });
+
+    for (const std::size_t k : wave) {
+      differentials_[diffs[k].first].push_back(matrices[k]);
+    }
+  }
+}
+
+GroupSequence& SpectralSequence::get_kernels(TrigradedIndex pqs)
+{
+  std::map<TrigradedIndex, GroupSequence>::iterator kers = kernels_.find(pqs);
+  if (kers == kernels_.end()) {
+    throw std::logic_error("SpectralSequence::get_kernels: Group is not set.");
+  }
+
+  return kers->second;
+}
+
+GroupSequence& SpectralSequence::get_cokernels(TrigradedIndex pqs)
+{
+  std::map<TrigradedIndex, GroupSequence>::iterator cokers =
+      cokernels_.find(pqs);
+  if (cokers == cokernels_.end()) {
+    throw std::logic_error(
+        "SpectralSequence::get_cokernels: Group is not set.");
+  }
+
+  return cokers->second;
+}
+
+std::pair<GroupSequence*, GroupSequence*> SpectralSequence::diff_sequences(
+    TrigradedIndex pqs, std::size_t r)
+{
+  const int r_int = static_cast<int>(r);
+  TrigradedIndex diff_offset(-r_int, r_int - 1, 1);
 
   std::map<TrigradedIndex, GroupSequence>::iterator cokers =
       cokernels_.find(pqs);
   std::map<TrigradedIndex, GroupSequence>::iterator kers =
-      cokernels_.find(pqs + diff_offset);
+      kernels_.find(pqs + diff_offset);
   if (kers == kernels_.end()) {
     throw std::logic_error("SpectralSequence::set_diff: Kernel is not set.");
   }
   if (cokers == cokernels_.end()) {
     throw std::logic_error("SpectralSequence::set_diff: Cokernel is not set.");
   }
-  if (kers->second.get_current() != r) {
+
+  // Done here rather than in update_sequences, which may run concurrently.
+  invalidate_e_ab(kers->first);
+  invalidate_e_ab(cokers->first);
+
+  return std::make_pair(&kers->second, &cokers->second);
+}
+
+void SpectralSequence::update_sequences(GroupSequence& kers,
+                                        GroupSequence& cokers, std::size_t r,
+                                        MatrixQ& matrix)
+{
+  if (kers.get_current() != r) {
     throw std::logic_error("SpectralSequence::set_diff: Kernel is at wrong r.");
   }
-  if (cokers->second.get_current() != r) {
+  if (cokers.get_current() != r) {
     throw std::logic_error(
         "SpectralSequence::set_diff: Cokernel is at wrong r.");
   }
 
-  AbelianGroup X = kers->second.get_group(r);
-  AbelianGroup Y = cokers->second.get_group(r);
+  AbelianGroup X = kers.get_group(r);
+  AbelianGroup Y = cokers.get_group(r);
+
+  // Reduced in place, so that the differential is kept reduced as well.
+  if (morphism_reduction()) reduce_morphism(prime_, matrix, Y);
 
   if (morphism_zero(prime_, matrix, Y)) {
-    kers->second.inc();
-    cokers->second.inc();
+    kers.inc();
+    cokers.inc();
     return;
   }
 
-  MatrixQ inc_X = kers->second.get_matrix(r);
-  MatrixQ proj_Y = cokers->second.get_matrix(r);
+  // Copies share their entries with the sequences until they are modified.
+  MatrixQList from_X = {kers.get_matrix(r)};
+  MatrixQList to_Y = {cokers.get_matrix(r)};
 
-  MatrixQList from_X, to_Y;
-  from_X.emplace_back(inc_X);
-  to_Y.emplace_back(proj_Y);
+  KernelAndCokernel new_groups =
+      compute_kernel_cokernel(prime_, matrix, X, Y, MatrixQRefList(),
+                              ref(from_X), ref(to_Y), MatrixQRefList(),
+                              MapRequest::MapsFrom, MapRequest::MapsTo);
 
-  GroupWithMorphisms new_kernel =
-      compute_kernel(prime_, matrix, X, Y, MatrixQRefList(), ref(from_X));
-  GroupWithMorphisms new_cokernel =
-      compute_cokernel(prime_, matrix, Y, ref(to_Y), MatrixQRefList());
+  // The kernels map into the group kers starts with. The cokernels receive
+  // maps into themselves, which compute_kernel_cokernel already reduced.
+  if (morphism_reduction()) {
+    reduce_morphism(prime_, new_groups.kernel.maps_from[0],
+                    kers.get_group(kers.get_index_min()));
+  }
 
-  kers->second.append(r + 1, new_kernel.group, new_kernel.maps_from[0]);
-  cokers->second.append(r + 1, new_cokernel.group, new_cokernel.maps_to[0]);
+  kers.append(r + 1, new_groups.kernel.group,
+              new_groups.kernel.maps_from[0]);
+  cokers.append(r + 1, new_groups.cokernel.group,
+                new_groups.cokernel.maps_to[0]);
 }
 
 const AbelianGroup& SpectralSequence::get_e_ab(TrigradedIndex pqs,
                                                std::size_t a, std::size_t b)
 {
+  const std::tuple<TrigradedIndex, std::size_t, std::size_t> key(pqs, a, b);
+
+  auto cached = e_ab_.find(key);
+  if (cached != e_ab_.end()) return cached->second;
+
+  GroupSequence& kers = get_kernels(pqs);
+  GroupSequence& cokers = get_cokernels(pqs);
+
+  MatrixQ f = cokers.get_matrix(b) * kers.get_matrix(a);
+  GroupWithMorphisms E = compute_image(prime_, f, kers.get_group(a),
+                                       cokers.get_group(b), MapRequest::None);
+
+  return e_ab_.emplace(key, E.group).first->second;
+}
+
+void SpectralSequence::invalidate_e_ab(TrigradedIndex pqs)
+{
+  auto it = e_ab_.lower_bound(std::make_tuple(pqs, 0, 0));
+  while (it != e_ab_.end() && std::get<0>(it->first) == pqs) {
+    it = e_ab_.erase(it);
+  }
 }
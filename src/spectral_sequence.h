@@ -1,7 +1,10 @@
 #pragma once
 
 #include <map>
+#include <tuple>
+#include <utility>
 #include <vector>
+
 #include "abelian_group.h"
 #include "morphisms.h"
 
@@ -44,9 +47,12 @@ class GroupSequence {
 	void append(const std::size_t index, const AbelianGroup& grp, const MatrixQ& map);
 	void done();
 	std::size_t get_current();
+	std::size_t get_index_min();
 	void inc();
 
  private:
+	friend class Checkpoint;
+
 	bool done_;
 	std::map<std::size_t, std::tuple<AbelianGroup,MatrixQ>> entries_;
 	std::size_t current_;
@@ -58,15 +64,43 @@ class GroupSequence {
 	//and all higher things are treated as equal to the highest one that has been set explicitly.
 };
 
+// Differentials of one page, each given by its target index and its matrix.
+typedef std::vector<std::pair<TrigradedIndex, MatrixQ>> DifferentialList;
+
 class SpectralSequence {
 
 public:
+	explicit SpectralSequence(const std::size_t prime);
+
+	// Sets the group at pqs on page r_min, the first page with differentials.
+	void set_group(TrigradedIndex pqs, std::size_t r_min, const AbelianGroup& grp);
 	void set_diff(TrigradedIndex pqs, std::size_t r, MatrixQ matrix);
+	// Sets all differentials of page r. Differentials touching different group
+	// sequences are computed concurrently on the threads configured by
+	// set_smith_threads, the others in the given order.
+	void set_diffs(std::size_t r, const DifferentialList& diffs);
+	// Image of the a-th kernel at pqs in its b-th cokernel, so E_r at pqs for
+	// a = b = r. Results are kept until a differential at pqs is set.
 	const AbelianGroup& get_e_ab(TrigradedIndex pqs, std::size_t a, std::size_t b);
+	// Kernels of the differentials leaving pqs and cokernels of those arriving.
+	GroupSequence& get_kernels(TrigradedIndex pqs);
+	GroupSequence& get_cokernels(TrigradedIndex pqs);
 private:
+	friend class Checkpoint;
+
+	// The kernel sequence at the source and the cokernel sequence at the target
+	// of the differential of page r with target pqs.
+	std::pair<GroupSequence*, GroupSequence*> diff_sequences(TrigradedIndex pqs,
+	                                                         std::size_t r);
+	void update_sequences(GroupSequence& kers, GroupSequence& cokers,
+	                      std::size_t r, MatrixQ& matrix);
+	void invalidate_e_ab(TrigradedIndex pqs);
+
 	std::map<TrigradedIndex, GroupSequence> kernels_;
 	std::map<TrigradedIndex, GroupSequence> cokernels_;
 	std::map<TrigradedIndex, MatrixQList> differentials_;
 	//const TrigradedIndex diff_offset_; oops, depends on r. Do we want a function object for that?
 	std::size_t prime_;
+	std::map<std::tuple<TrigradedIndex, std::size_t, std::size_t>, AbelianGroup>
+	    e_ab_;
 };
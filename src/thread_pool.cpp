@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+
+#include <exception>
+
+#include "gmp_arena.h"
+
+ThreadPool::ThreadPool(const std::size_t threads) : stop_(false)
+{
+  for (std::size_t k = 0; k < threads; ++k) {
+    workers_.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ThreadPool::run_pending_task(std::unique_lock<std::mutex>& lock)
+{
+  if (tasks_.empty()) return false;
+
+  std::function<void()> task = std::move(tasks_.front());
+  tasks_.pop_front();
+
+  // The task may belong to another computation than the one this thread is
+  // waiting for, so its GMP values must not end up in our arena.
+  lock.unlock();
+  {
+    GmpArena::Suspend suspend;
+    task();
+  }
+  lock.lock();
+
+  return true;
+}
+
+void ThreadPool::work()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    if (run_pending_task(lock)) continue;
+    if (stop_) return;
+
+    changed_.wait(lock);
+  }
+}
+
+void ThreadPool::parallel_for(
+    const std::size_t begin, const std::size_t end, const std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)>& body)
+{
+  if (begin >= end) return;
+
+  const std::size_t length = end - begin;
+  const std::size_t max_chunks = 4 * (size() + 1);
+  std::size_t chunks = length / (grain ? grain : 1);
+  if (chunks == 0) chunks = 1;
+  if (chunks > max_chunks) chunks = max_chunks;
+
+  if (chunks == 1) {
+    body(begin, end);
+    return;
+  }
+
+  std::size_t remaining = chunks;
+  std::exception_ptr error;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (std::size_t k = 0; k < chunks; ++k) {
+    const std::size_t chunk_begin = begin + length * k / chunks;
+    const std::size_t chunk_end = begin + length * (k + 1) / chunks;
+
+    tasks_.emplace_back([this, &body, &remaining, &error, chunk_begin,
+                         chunk_end]() {
+      std::exception_ptr chunk_error;
+      try {
+        body(chunk_begin, chunk_end);
+      } catch (...) {
+        chunk_error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (chunk_error && !error) error = chunk_error;
+      if (--remaining == 0) changed_.notify_all();
+    });
+  }
+  changed_.notify_all();
+
+  while (remaining > 0) {
+    if (!run_pending_task(lock)) changed_.wait(lock);
+  }
+
+  if (error) std::rethrow_exception(error);
+}
+
+void parallel_for(ThreadPool* pool, const std::size_t begin,
+                  const std::size_t end, const std::size_t grain,
+                  const std::function<void(std::size_t, std::size_t)>& body)
+{
+  if (pool)
+    pool->parallel_for(begin, end, grain, body);
+  else if (begin < end)
+    body(begin, end);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads executing ranges of independent work.
+//
+// A thread waiting in parallel_for executes pending tasks itself, so
+// parallel_for can be nested inside tasks without deadlocking the pool.
+class ThreadPool
+{
+ public:
+  explicit ThreadPool(const std::size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  inline std::size_t size() const
+  {
+    return workers_.size();
+  }
+
+  // Calls body(chunk_begin, chunk_end) on disjoint chunks of at least grain
+  // indices covering [begin, end), and returns once all of them finished. The
+  // first exception thrown by body is rethrown.
+  void parallel_for(const std::size_t begin, const std::size_t end,
+                    const std::size_t grain,
+                    const std::function<void(std::size_t, std::size_t)>& body);
+
+ private:
+  bool run_pending_task(std::unique_lock<std::mutex>& lock);
+  void work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool stop_;
+};
+
+// Runs body on [begin, end) using pool, or directly if pool is null.
+void parallel_for(ThreadPool* pool, const std::size_t begin,
+                  const std::size_t end, const std::size_t grain,
+                  const std::function<void(std::size_t, std::size_t)>& body);
+
+// Thread-local arithmetic state of the coefficient type T, captured on the
+// thread starting parallel work and installed on the workers by a Scope.
+template <typename T>
+struct ThreadContext {
+  struct Scope {
+    explicit Scope(const ThreadContext<T>&)
+    {
+    }
+  };
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+
+#include "matrix.h"
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+
+// Compact record of the basis changes made on one side of a Smith reduction.
+//
+// add, mul and swap take the same arguments as basis_vectors_add,
+// basis_vectors_mul and basis_vectors_swap. Replaying the log on lists to_X
+// and from_X has the same effect as having called those functions on them
+// eagerly, but can be restricted to the matrices, and to the columns of to_X
+// or the rows of from_X, that are actually needed.
+template <typename T>
+class TransformLog
+{
+ public:
+  // A log that is not recording drops all operations, for sides of a
+  // reduction whose transforms nobody asked for.
+  explicit TransformLog(const bool recording = true);
+
+  inline bool recording() const
+  {
+    return recording_;
+  }
+
+  void add(const std::size_t i1, const std::size_t i2, const T& lambda);
+  void mul(const std::size_t i, const T& lambda);
+  void swap(const std::size_t i1, const std::size_t i2);
+
+  inline std::size_t size() const
+  {
+    return ops_.size();
+  }
+
+  // Replays the log on the columns [j_begin, j_end) of a matrix mapping to
+  // the basis, i.e. an element of to_X.
+  template <typename L>
+  void apply_to(Matrix<T, L>& f, const std::size_t j_begin,
+                const std::size_t j_end) const;
+  template <typename L>
+  void apply_to(Matrix<T, L>& f) const;
+  // Sparse variant, at a cost in the entries of the rows it combines rather
+  // than in the width of f.
+  void apply_to(SparseMatrix<T>& f) const;
+
+  // Replays the log on the rows [i_begin, i_end) of a matrix mapping from
+  // the basis, i.e. an element of from_X.
+  template <typename L>
+  void apply_from(Matrix<T, L>& f, const std::size_t i_begin,
+                  const std::size_t i_end) const;
+  template <typename L>
+  void apply_from(Matrix<T, L>& f) const;
+
+  // Replays the log on all matrices, in blocks small enough to stay in cache.
+  // The blocks are independent and are distributed over pool if given.
+  // Compact matrices stay compact up to the first addition, from which on
+  // the log is replayed on their dense entries.
+  template <typename LT, typename LF>
+  void apply(MatrixRefList<T, LT>& to_X, MatrixRefList<T, LF>& from_X,
+             ThreadPool* pool = nullptr) const;
+
+ private:
+  enum class Kind : unsigned char { Add, Mul, Swap };
+
+  struct Operation {
+    Kind kind;
+    std::size_t i1;
+    std::size_t i2;
+    T lambda;
+  };
+
+  bool recording_;
+  // Replays the log on a compact matrix up to and including the first
+  // addition that expands it, and returns the index of the operation after
+  // that addition, from which the dense replay continues.
+  template <typename L>
+  std::size_t apply_compact_to(Matrix<T, L>& f) const;
+  template <typename L>
+  std::size_t apply_compact_from(Matrix<T, L>& f) const;
+
+  template <typename L>
+  void apply_to(Matrix<T, L>& f, const std::size_t first,
+                const std::size_t j_begin, const std::size_t j_end) const;
+  template <typename L>
+  void apply_from(Matrix<T, L>& f, const std::size_t first,
+                  const std::size_t i_begin, const std::size_t i_end) const;
+
+  std::vector<Operation> ops_;
+  // Inverses of the multipliers of mul, indexed by Operation::i2.
+  std::vector<T> inverses_;
+};
+
+#include "transform_log_impl.h"
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <utility>
+
+// Number of entries replayed at once by TransformLog::apply.
+const std::size_t TRANSFORM_LOG_BLOCK_ENTRIES = 1 << 12;
+
+template <typename T>
+TransformLog<T>::TransformLog(const bool recording) : recording_(recording)
+{
+}
+
+template <typename T>
+void TransformLog<T>::add(const std::size_t i1, const std::size_t i2,
+                          const T& lambda)
+{
+  if (!recording_) return;
+
+  ops_.push_back(Operation{Kind::Add, i1, i2, lambda});
+}
+
+template <typename T>
+void TransformLog<T>::mul(const std::size_t i, const T& lambda)
+{
+  if (!recording_) return;
+
+  ops_.push_back(Operation{Kind::Mul, i, inverses_.size(), lambda});
+  inverses_.push_back(1 / lambda);
+}
+
+template <typename T>
+void TransformLog<T>::swap(const std::size_t i1, const std::size_t i2)
+{
+  if (!recording_ || i1 == i2) return;
+
+  ops_.push_back(Operation{Kind::Swap, i1, i2, T()});
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_to(Matrix<T, L>& f, const std::size_t j_begin,
+                               const std::size_t j_end) const
+{
+  apply_to(f, 0, j_begin, j_end);
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_to(Matrix<T, L>& f, const std::size_t first,
+                               const std::size_t j_begin,
+                               const std::size_t j_end) const
+{
+  using std::swap;
+
+  for (std::size_t k = first; k < ops_.size(); ++k) {
+    const Operation& op = ops_[k];
+    switch (op.kind) {
+      case Kind::Add:
+        for (std::size_t j = j_begin; j < j_end; ++j) {
+          f(op.i1, j) -= op.lambda * f(op.i2, j);
+        }
+        break;
+      case Kind::Mul:
+        for (std::size_t j = j_begin; j < j_end; ++j) {
+          f(op.i1, j) *= inverses_[op.i2];
+        }
+        break;
+      case Kind::Swap:
+        for (std::size_t j = j_begin; j < j_end; ++j) {
+          swap(f(op.i1, j), f(op.i2, j));
+        }
+        break;
+    }
+  }
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_to(Matrix<T, L>& f) const
+{
+  apply_to(f, 0, f.width());
+}
+
+template <typename T>
+void TransformLog<T>::apply_to(SparseMatrix<T>& f) const
+{
+  for (const Operation& op : ops_) {
+    if (op.kind == Kind::Add) {
+      f.row_add(op.i2, op.i1, -op.lambda);
+    } else if (op.kind == Kind::Mul) {
+      f.row_mul(op.i1, inverses_[op.i2]);
+    } else {
+      f.row_swap(op.i1, op.i2);
+    }
+  }
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_from(Matrix<T, L>& f, const std::size_t i_begin,
+                                 const std::size_t i_end) const
+{
+  apply_from(f, 0, i_begin, i_end);
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_from(Matrix<T, L>& f, const std::size_t first,
+                                 const std::size_t i_begin,
+                                 const std::size_t i_end) const
+{
+  using std::swap;
+
+  for (std::size_t k = first; k < ops_.size(); ++k) {
+    const Operation& op = ops_[k];
+    switch (op.kind) {
+      case Kind::Add:
+        for (std::size_t i = i_begin; i < i_end; ++i) {
+          f(i, op.i2) += op.lambda * f(i, op.i1);
+        }
+        break;
+      case Kind::Mul:
+        for (std::size_t i = i_begin; i < i_end; ++i) {
+          f(i, op.i1) *= op.lambda;
+        }
+        break;
+      case Kind::Swap:
+        for (std::size_t i = i_begin; i < i_end; ++i) {
+          swap(f(i, op.i1), f(i, op.i2));
+        }
+        break;
+    }
+  }
+}
+
+template <typename T>
+template <typename L>
+void TransformLog<T>::apply_from(Matrix<T, L>& f) const
+{
+  apply_from(f, 0, f.height());
+}
+
+template <typename T>
+template <typename L>
+std::size_t TransformLog<T>::apply_compact_to(Matrix<T, L>& f) const
+{
+  std::size_t k = 0;
+  for (; k < ops_.size() && f.compact(); ++k) {
+    const Operation& op = ops_[k];
+    if (op.kind == Kind::Add) {
+      f.row_add(op.i2, op.i1, -op.lambda);
+    } else if (op.kind == Kind::Mul) {
+      f.row_mul(op.i1, inverses_[op.i2]);
+    } else {
+      f.row_swap(op.i1, op.i2);
+    }
+  }
+
+  return k;
+}
+
+template <typename T>
+template <typename L>
+std::size_t TransformLog<T>::apply_compact_from(Matrix<T, L>& f) const
+{
+  std::size_t k = 0;
+  for (; k < ops_.size() && f.compact(); ++k) {
+    const Operation& op = ops_[k];
+    if (op.kind == Kind::Add) {
+      f.col_add(op.i1, op.i2, op.lambda);
+    } else if (op.kind == Kind::Mul) {
+      f.col_mul(op.i1, op.lambda);
+    } else {
+      f.col_swap(op.i1, op.i2);
+    }
+  }
+
+  return k;
+}
+
+template <typename T>
+template <typename LT, typename LF>
+void TransformLog<T>::apply(MatrixRefList<T, LT>& to_X,
+                            MatrixRefList<T, LF>& from_X,
+                            ThreadPool* pool) const
+{
+  ThreadContext<T> context;
+
+#ifdef AKSS_COUNTERS
+  std::size_t adds = 0, muls = 0, swaps = 0;
+  for (const Operation& op : ops_) {
+    if (op.kind == Kind::Add) ++adds;
+    if (op.kind == Kind::Mul) ++muls;
+    if (op.kind == Kind::Swap) ++swaps;
+  }
+  AKSS_COUNT_N(RowAdd, adds * to_X.size());
+  AKSS_COUNT_N(RowMul, muls * to_X.size());
+  AKSS_COUNT_N(RowSwap, swaps * to_X.size());
+  AKSS_COUNT_N(ColAdd, adds * from_X.size());
+  AKSS_COUNT_N(ColMul, muls * from_X.size());
+  AKSS_COUNT_N(ColSwap, swaps * from_X.size());
+#endif
+
+  for (Matrix<T, LT>& f : to_X) {
+    const std::size_t first = apply_compact_to(f);
+    if (f.compact()) continue;
+    f.detach();
+    const std::size_t block = TRANSFORM_LOG_BLOCK_ENTRIES / (f.height() + 1) + 1;
+    const std::size_t blocks = (f.width() + block - 1) / block;
+
+    parallel_for(pool, 0, blocks, 1, [&](std::size_t begin, std::size_t end) {
+      typename ThreadContext<T>::Scope scope(context);
+      for (std::size_t b = begin; b < end; ++b) {
+        apply_to(f, first, b * block, std::min((b + 1) * block, f.width()));
+      }
+    });
+  }
+
+  for (Matrix<T, LF>& f : from_X) {
+    const std::size_t first = apply_compact_from(f);
+    if (f.compact()) continue;
+    f.detach();
+    const std::size_t block = TRANSFORM_LOG_BLOCK_ENTRIES / (f.width() + 1) + 1;
+    const std::size_t blocks = (f.height() + block - 1) / block;
+
+    parallel_for(pool, 0, blocks, 1, [&](std::size_t begin, std::size_t end) {
+      typename ThreadContext<T>::Scope scope(context);
+      for (std::size_t b = begin; b < end; ++b) {
+        apply_from(f, first, b * block,
+                   std::min((b + 1) * block, f.height()));
+      }
+    });
+  }
+}
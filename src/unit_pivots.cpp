@@ -0,0 +1,153 @@
+#include "unit_pivots.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+std::uint64_t inverse_mod_p(const std::uint64_t a, const std::uint64_t p)
+{
+  std::int64_t r0 = static_cast<std::int64_t>(p);
+  std::int64_t r1 = static_cast<std::int64_t>(a);
+  std::int64_t t0 = 0, t1 = 1;
+
+  while (r1 != 0) {
+    const std::int64_t q = r0 / r1;
+    std::int64_t r2 = r0 - q * r1;
+    std::int64_t t2 = t0 - q * t1;
+    r0 = r1;
+    r1 = r2;
+    t0 = t1;
+    t1 = t2;
+  }
+
+  if (t0 < 0) t0 += static_cast<std::int64_t>(p);
+  return static_cast<std::uint64_t>(t0);
+}
+
+// F_2 variant of find_unit_pivots with rows packed into 64-bit words, so that
+// an elimination step is a word-wise XOR of rows.
+std::vector<std::pair<std::size_t, std::size_t>> find_unit_pivots_2(
+    const std::size_t height, const std::size_t width,
+    const std::vector<std::uint32_t>& residues)
+{
+  const std::size_t words = (width + 63) / 64;
+  std::vector<std::uint64_t> bits(height * words);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      if (residues[i * width + j] & 1)
+        bits[i * words + j / 64] |= std::uint64_t(1) << (j % 64);
+    }
+  }
+
+  std::vector<std::pair<std::size_t, std::size_t>> pivots;
+  std::uint64_t* a = bits.data();
+
+  for (std::size_t d = 0; d < std::min(height, width); ++d) {
+    const std::size_t d_word = d / 64;
+    const std::uint64_t d_bit = std::uint64_t(1) << (d % 64);
+    // Bits of the word containing column d that belong to columns >= d.
+    const std::uint64_t trailing = ~(d_bit - 1);
+
+    std::size_t i_pivot = height;
+    std::size_t j_pivot = width;
+    for (std::size_t i = d; i < height && i_pivot == height; ++i) {
+      const std::uint64_t* row = a + i * words;
+      for (std::size_t w = d_word; w < words; ++w) {
+        const std::uint64_t word = w == d_word ? row[w] & trailing : row[w];
+        if (word) {
+          i_pivot = i;
+          j_pivot = w * 64 + static_cast<std::size_t>(__builtin_ctzll(word));
+          break;
+        }
+      }
+    }
+    if (i_pivot == height) break;
+
+    pivots.emplace_back(i_pivot, j_pivot);
+
+    if (i_pivot != d)
+      std::swap_ranges(a + i_pivot * words, a + (i_pivot + 1) * words,
+                       a + d * words);
+    if (j_pivot != d) {
+      const std::size_t j_word = j_pivot / 64;
+      const std::uint64_t j_bit = std::uint64_t(1) << (j_pivot % 64);
+      for (std::size_t i = d; i < height; ++i) {
+        std::uint64_t* row = a + i * words;
+        const bool at_d = row[d_word] & d_bit;
+        const bool at_j = row[j_word] & j_bit;
+        if (at_d == at_j) continue;
+        row[d_word] ^= d_bit;
+        row[j_word] ^= j_bit;
+      }
+    }
+
+    const std::uint64_t* pivot_row = a + d * words;
+    for (std::size_t i = d + 1; i < height; ++i) {
+      std::uint64_t* row = a + i * words;
+      if (!(row[d_word] & d_bit)) continue;
+
+      for (std::size_t w = d_word; w < words; ++w) row[w] ^= pivot_row[w];
+    }
+  }
+
+  return pivots;
+}
+
+}  // namespace
+
+std::vector<std::pair<std::size_t, std::size_t>> find_unit_pivots(
+    const std::uint64_t p, const std::size_t height, const std::size_t width,
+    std::vector<std::uint32_t>& residues)
+{
+  if (p >> 32) throw std::logic_error("find_unit_pivots: p >= 2^32");
+  if (residues.size() != height * width)
+    throw std::logic_error("find_unit_pivots: wrong number of residues");
+
+  if (p == 2) return find_unit_pivots_2(height, width, residues);
+
+  std::vector<std::pair<std::size_t, std::size_t>> pivots;
+  std::uint32_t* a = residues.data();
+
+  for (std::size_t d = 0; d < std::min(height, width); ++d) {
+    std::size_t i_pivot = height;
+    std::size_t j_pivot = width;
+    for (std::size_t i = d; i < height && i_pivot == height; ++i) {
+      const std::uint32_t* row = a + i * width;
+      for (std::size_t j = d; j < width; ++j) {
+        if (row[j]) {
+          i_pivot = i;
+          j_pivot = j;
+          break;
+        }
+      }
+    }
+    if (i_pivot == height) break;
+
+    pivots.emplace_back(i_pivot, j_pivot);
+
+    if (i_pivot != d)
+      std::swap_ranges(a + i_pivot * width, a + (i_pivot + 1) * width,
+                       a + d * width);
+    if (j_pivot != d) {
+      for (std::size_t i = d; i < height; ++i)
+        std::swap(a[i * width + j_pivot], a[i * width + d]);
+    }
+
+    // Only the trailing block matters for the following steps, so the pivot
+    // row and column are left as they are.
+    const std::uint32_t* pivot_row = a + d * width;
+    const std::uint64_t inverse = inverse_mod_p(pivot_row[d], p);
+    for (std::size_t i = d + 1; i < height; ++i) {
+      std::uint32_t* row = a + i * width;
+      if (!row[d]) continue;
+
+      const std::uint64_t lambda = p - row[d] * inverse % p;
+      for (std::size_t j = d + 1; j < width; ++j) {
+        row[j] = static_cast<std::uint32_t>((row[j] + lambda * pivot_row[j]) % p);
+      }
+    }
+  }
+
+  return pivots;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Runs the dense Smith reduction over F_p, p < 2^32, on a row-major height x
+// width matrix of residues, which may be overwritten. Every nonzero entry is a
+// unit there, so the first one found in the trailing block is taken as the
+// pivot of each step and swapped to the diagonal. For p = 2 the rows are
+// packed into bits.
+//
+// Returns the pivot of every step as a position in the matrix as it is before
+// that step, i.e. after the swaps of all previous steps. Since eliminating
+// with a unit pivot commutes with reduction mod p, these are also units of a
+// p-local reduction taking the same pivots, in the same order.
+std::vector<std::pair<std::size_t, std::size_t>> find_unit_pivots(
+    const std::uint64_t p, const std::size_t height, const std::size_t width,
+    std::vector<std::uint32_t>& residues);
@@ -0,0 +1,301 @@
+#include "zpn.h"
+
+#include <exception>
+#include <string>
+
+#include "counters.h"
+#include "mod_kernels.h"
+
+__extension__ typedef unsigned __int128 uint128;
+__extension__ typedef __int128 int128;
+
+static_assert(sizeof(Zpn) == sizeof(std::uint64_t),
+              "Zpn must be laid out as its residue");
+
+thread_local const Zpn::Context* Zpn::current_ = nullptr;
+
+Zpn::Precision::Precision(const std::size_t p, const std::size_t n)
+    : previous_(current_)
+{
+  if (!fits(p, n))
+    throw std::logic_error("Zpn::Precision: p^" + std::to_string(n) +
+                           " does not fit into a word");
+
+  context_.p = p;
+  context_.n = n;
+  context_.powers.push_back(1);
+  for (std::size_t k = 0; k < n; ++k)
+    context_.powers.push_back(context_.powers.back() * p);
+
+  current_ = &context_;
+}
+
+Zpn::Precision::~Precision()
+{
+  current_ = previous_;
+}
+
+bool Zpn::fits(const std::size_t p, const std::size_t n)
+{
+  // Sums of two residues have to fit into 63 bits.
+  const std::uint64_t bound = std::uint64_t(1) << 62;
+
+  if (p < 2 || n == 0) return false;
+
+  std::uint64_t pow = 1;
+  for (std::size_t k = 0; k < n; ++k) {
+    if (pow > bound / p) return false;
+    pow *= p;
+  }
+
+  return true;
+}
+
+std::size_t Zpn::current_prime()
+{
+  return current_ ? current_->p : 0;
+}
+
+std::size_t Zpn::current_precision()
+{
+  return current_ ? current_->n : 0;
+}
+
+const Zpn::Context& Zpn::context()
+{
+  if (!current_) throw std::logic_error("Zpn: no precision in scope");
+
+  return *current_;
+}
+
+std::uint64_t Zpn::mul_mod(const std::uint64_t a, const std::uint64_t b,
+                           const std::uint64_t m)
+{
+  // Moduli 2^n, i.e. p = 2, reduce the product modulo 2^64 by a mask.
+  if (!(m & (m - 1))) return a * b & (m - 1);
+
+  return static_cast<std::uint64_t>(uint128(a) * b % m);
+}
+
+std::uint64_t Zpn::inverse_mod(const std::uint64_t a, const std::uint64_t m)
+{
+  if (!(m & (m - 1))) {
+    if (!(a & 1)) throw std::logic_error("Zpn::inverse_mod: not a unit");
+
+    // Odd a are their own inverses modulo 8, and every Newton step doubles
+    // the number of correct low bits.
+    std::uint64_t x = a;
+    for (std::size_t k = 0; k < 5; ++k) x *= 2 - a * x;
+    return x & (m - 1);
+  }
+
+  int128 r0 = m, r1 = a % m;
+  int128 t0 = 0, t1 = 1;
+
+  while (r1 != 0) {
+    int128 q = r0 / r1;
+    int128 r2 = r0 - q * r1;
+    int128 t2 = t0 - q * t1;
+    r0 = r1;
+    r1 = r2;
+    t0 = t1;
+    t1 = t2;
+  }
+
+  if (r0 != 1) throw std::logic_error("Zpn::inverse_mod: not a unit");
+  if (t0 < 0) t0 += m;
+
+  return static_cast<std::uint64_t>(t0);
+}
+
+Zpn::Zpn() : residue_(0)
+{
+}
+
+Zpn::Zpn(const long x) : residue_(0)
+{
+  if (x == 0) return;
+
+  const std::uint64_t modulus = context().powers.back();
+  if (x > 0)
+    residue_ = static_cast<std::uint64_t>(x) % modulus;
+  else
+    residue_ = (modulus - static_cast<std::uint64_t>(-(x + 1)) % modulus - 1) %
+               modulus;
+}
+
+Zpn::Zpn(const mpz_class& x) : residue_(0)
+{
+  const std::uint64_t modulus = context().powers.back();
+
+  residue_ = mpz_fdiv_ui(x.get_mpz_t(), modulus);
+}
+
+Zpn::Zpn(const mpq_class& x) : residue_(0)
+{
+  const Context& ctx = context();
+  const std::uint64_t modulus = ctx.powers.back();
+
+  std::uint64_t den = mpz_fdiv_ui(x.get_den_mpz_t(), modulus);
+  if (den % ctx.p == 0)
+    throw std::logic_error("Zpn: rational number is not p-integral");
+
+  std::uint64_t num = mpz_fdiv_ui(x.get_num_mpz_t(), modulus);
+  residue_ = mul_mod(num, inverse_mod(den, modulus), modulus);
+}
+
+std::size_t Zpn::valuation() const
+{
+  if (!residue_) throw std::logic_error("Zpn::valuation: x=0");
+
+  const std::uint64_t p = context().p;
+  if (p == 2) return static_cast<std::size_t>(__builtin_ctzll(residue_));
+
+  std::uint64_t residue = residue_;
+  std::size_t valuation = 0;
+  while (residue % p == 0) {
+    residue /= p;
+    ++valuation;
+  }
+
+  return valuation;
+}
+
+mpz_class Zpn::get_mpz() const
+{
+  return mpz_class(static_cast<unsigned long>(residue_));
+}
+
+Zpn Zpn::operator-() const
+{
+  Zpn neg;
+  if (residue_) neg.residue_ = context().powers.back() - residue_;
+  return neg;
+}
+
+Zpn& Zpn::operator+=(const Zpn& other)
+{
+  if (!other.residue_) return *this;
+
+  const std::uint64_t modulus = context().powers.back();
+  residue_ += other.residue_;
+  if (residue_ >= modulus) residue_ -= modulus;
+
+  return *this;
+}
+
+Zpn& Zpn::operator-=(const Zpn& other)
+{
+  return (*this += -other);
+}
+
+Zpn& Zpn::operator*=(const Zpn& other)
+{
+  if (!residue_) return *this;
+  if (!other.residue_) return (*this = other);
+
+  residue_ = mul_mod(residue_, other.residue_, context().powers.back());
+  return *this;
+}
+
+Zpn& Zpn::operator/=(const Zpn& other)
+{
+  if (!other.residue_)
+    throw std::logic_error("Zpn::operator/=: division by 0");
+  if (!residue_) return *this;
+
+  const std::size_t other_valuation = other.valuation();
+  if (valuation() < other_valuation)
+    throw std::logic_error("Zpn::operator/=: quotient is not p-integral");
+
+  // Both residues are divisible by p^other_valuation as integers; the unit
+  // part of other is invertible modulo p^n.
+  const Context& ctx = context();
+  const std::uint64_t modulus = ctx.powers.back();
+  const std::uint64_t pow = ctx.powers[other_valuation];
+  residue_ = mul_mod(residue_ / pow,
+                     inverse_mod(other.residue_ / pow, modulus), modulus);
+  return *this;
+}
+
+Zpn operator+(Zpn a, const Zpn& b)
+{
+  return (a += b);
+}
+
+Zpn operator-(Zpn a, const Zpn& b)
+{
+  return (a -= b);
+}
+
+Zpn operator*(Zpn a, const Zpn& b)
+{
+  return (a *= b);
+}
+
+Zpn operator/(Zpn a, const Zpn& b)
+{
+  return (a /= b);
+}
+
+bool operator==(const Zpn& a, const Zpn& b)
+{
+  return a.residue_ == b.residue_;
+}
+
+bool operator!=(const Zpn& a, const Zpn& b)
+{
+  return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& stream, const Zpn& x)
+{
+  return (stream << x.get_mpz());
+}
+
+long p_val_q(const std::size_t, const Zpn& x)
+{
+  AKSS_COUNT(PValQ);
+
+  return static_cast<long>(x.valuation());
+}
+
+bool residue_mod_p(const std::size_t p, const Zpn& x, std::uint32_t& residue)
+{
+  residue =
+      static_cast<std::uint32_t>(p == 2 ? x.residue_ & 1 : x.residue_ % p);
+  return true;
+}
+
+void EntryKernels<Zpn>::add_mul(Zpn* y, const std::size_t y_stride,
+                                const Zpn* x, const std::size_t x_stride,
+                                const std::size_t n, const Zpn& lambda)
+{
+  if (!lambda.residue_ || !n) return;
+
+  const std::uint64_t modulus = Zpn::context().powers.back();
+  if (y_stride == 1 && x_stride == 1 && !(modulus >> 32)) {
+    mod_add_mul(&y->residue_, &x->residue_, n, lambda.residue_, modulus);
+    return;
+  }
+
+  for (std::size_t k = 0; k < n; ++k) {
+    y[k * y_stride] += lambda * x[k * x_stride];
+  }
+}
+
+void EntryKernels<Zpn>::mul(Zpn* x, const std::size_t stride,
+                            const std::size_t n, const Zpn& lambda)
+{
+  if (!n) return;
+
+  const std::uint64_t modulus = Zpn::context().powers.back();
+  if (stride == 1 && !(modulus >> 32)) {
+    mod_mul(&x->residue_, n, lambda.residue_, modulus);
+    return;
+  }
+
+  for (std::size_t k = 0; k < n; ++k) {
+    x[k * stride] *= lambda;
+  }
+}
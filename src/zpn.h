@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "matrix.h"
+#include "thread_pool.h"
+
+// Element of Z/p^n with word-sized residues.
+//
+// The prime p and the precision n are not part of the element; they are taken
+// from the innermost Zpn::Precision in scope on the calling thread. Zero is
+// represented independently of the precision, so default constructed matrices
+// of Zpn can be created outside of a scope.
+class Zpn
+{
+  struct Context {
+    std::uint64_t p;
+    std::size_t n;
+    std::vector<std::uint64_t> powers;
+  };
+
+ public:
+  class Precision
+  {
+   public:
+    Precision(const std::size_t p, const std::size_t n);
+    ~Precision();
+
+    Precision(const Precision&) = delete;
+    Precision& operator=(const Precision&) = delete;
+
+   private:
+    Context context_;
+    const Context* previous_;
+  };
+
+  // Whether p^n can be used as the modulus of a Zpn::Precision.
+  static bool fits(const std::size_t p, const std::size_t n);
+
+  // Prime and precision of the innermost scope, or 0 if there is none.
+  static std::size_t current_prime();
+  static std::size_t current_precision();
+
+  Zpn();
+  Zpn(const long x);
+  Zpn(const mpz_class& x);
+  Zpn(const mpq_class& x);
+
+  explicit inline operator bool() const
+  {
+    return residue_ != 0;
+  }
+
+  std::size_t valuation() const;
+  mpz_class get_mpz() const;
+
+  Zpn operator-() const;
+  Zpn& operator+=(const Zpn& other);
+  Zpn& operator-=(const Zpn& other);
+  Zpn& operator*=(const Zpn& other);
+  Zpn& operator/=(const Zpn& other);
+
+  friend Zpn operator+(Zpn a, const Zpn& b);
+  friend Zpn operator-(Zpn a, const Zpn& b);
+  friend Zpn operator*(Zpn a, const Zpn& b);
+  friend Zpn operator/(Zpn a, const Zpn& b);
+
+  friend bool operator==(const Zpn& a, const Zpn& b);
+  friend bool operator!=(const Zpn& a, const Zpn& b);
+
+  friend bool residue_mod_p(const std::size_t p, const Zpn& x,
+                            std::uint32_t& residue);
+
+  friend struct EntryKernels<Zpn>;
+
+ private:
+  static const Context& context();
+  static std::uint64_t mul_mod(const std::uint64_t a, const std::uint64_t b,
+                               const std::uint64_t m);
+  static std::uint64_t inverse_mod(const std::uint64_t a,
+                                   const std::uint64_t m);
+
+  // Reduced modulo p^n. Matrices of Zpn are handed to the kernels of
+  // mod_kernels.h as arrays of residues, so this has to stay the only member.
+  std::uint64_t residue_;
+
+  static thread_local const Context* current_;
+};
+
+Zpn operator+(Zpn a, const Zpn& b);
+Zpn operator-(Zpn a, const Zpn& b);
+Zpn operator*(Zpn a, const Zpn& b);
+Zpn operator/(Zpn a, const Zpn& b);
+
+bool operator==(const Zpn& a, const Zpn& b);
+bool operator!=(const Zpn& a, const Zpn& b);
+
+std::ostream& operator<<(std::ostream& stream, const Zpn& x);
+
+long p_val_q(const std::size_t p, const Zpn& x);
+bool residue_mod_p(const std::size_t p, const Zpn& x, std::uint32_t& residue);
+
+// Contiguous runs of entries go through mod_kernels.h if p^n < 2^32.
+template <>
+struct EntryKernels<Zpn> {
+  static void add_mul(Zpn* y, const std::size_t y_stride, const Zpn* x,
+                      const std::size_t x_stride, const std::size_t n,
+                      const Zpn& lambda);
+  static void mul(Zpn* x, const std::size_t stride, const std::size_t n,
+                  const Zpn& lambda);
+};
+
+// Carries the precision of the thread starting parallel work to the workers.
+template <>
+struct ThreadContext<Zpn> {
+  ThreadContext() : p(Zpn::current_prime()), n(Zpn::current_precision())
+  {
+  }
+
+  struct Scope {
+    explicit Scope(const ThreadContext<Zpn>& context)
+    {
+      if (context.n) precision_.reset(new Zpn::Precision(context.p, context.n));
+    }
+
+   private:
+    std::unique_ptr<Zpn::Precision> precision_;
+  };
+
+  std::size_t p;
+  std::size_t n;
+};
@@ -0,0 +1,129 @@
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/checkpoint.h"
+
+namespace {
+
+SpectralSequence example_sequence()
+{
+  AbelianGroup Z9(0, 1);
+  Z9(0) = 2;
+  AbelianGroup Z27_Z(1, 1);
+  Z27_Z(0) = 3;
+
+  SpectralSequence spec(3);
+  spec.set_group(TrigradedIndex(0, 1, 1), 2, Z9);
+  spec.set_group(TrigradedIndex(2, 0, 0), 2, Z27_Z);
+  spec.set_group(TrigradedIndex(1, 1, 1), 2, Z9);
+  spec.set_group(TrigradedIndex(3, 0, 0), 2, Z9);
+
+  // Entries spanning several limbs, with signs and denominators.
+  const mpq_class big("-3802951800684688204490109616129/5");
+  DifferentialList diffs;
+  diffs.emplace_back(TrigradedIndex(2, 0, 0), MatrixQ({{3 * big}, {0}}));
+  diffs.emplace_back(TrigradedIndex(3, 0, 0), MatrixQ({{mpq_class(9, 7)}}));
+  spec.set_diffs(2, diffs);
+
+  return spec;
+}
+
+std::string checkpoint_path(const std::string& name)
+{
+  return ::testing::TempDir() + name;
+}
+
+}  // namespace
+
+TEST(Checkpoint, RoundTrip)
+{
+  SpectralSequence spec = example_sequence();
+  const std::vector<char> data = Checkpoint::serialize(spec);
+
+  const std::string path = checkpoint_path("akss_round_trip.ckpt");
+  Checkpoint::save(spec, path);
+  SpectralSequence loaded = Checkpoint::load(path);
+
+  EXPECT_EQ(data, Checkpoint::serialize(loaded));
+
+  GroupSequence& kers = loaded.get_kernels(TrigradedIndex(0, 1, 1));
+  EXPECT_EQ(3, kers.get_current());
+  EXPECT_EQ(spec.get_kernels(TrigradedIndex(0, 1, 1)).get_matrix(3),
+            kers.get_matrix(3));
+
+  const AbelianGroup& E = loaded.get_e_ab(TrigradedIndex(2, 0, 0), 2, 3);
+  ASSERT_EQ(1, E.tor_rank());
+  EXPECT_EQ(1, E(0));
+  EXPECT_EQ(1, E.free_rank());
+
+  std::remove(path.c_str());
+}
+
+TEST(Checkpoint, Invalid)
+{
+  std::vector<char> data = Checkpoint::serialize(example_sequence());
+
+  EXPECT_THROW(Checkpoint::deserialize(data.data(), data.size() - 1),
+               std::logic_error);
+
+  data.push_back(0);
+  EXPECT_THROW(Checkpoint::deserialize(data.data(), data.size()),
+               std::logic_error);
+
+  data[0] = 'X';
+  EXPECT_THROW(Checkpoint::deserialize(data.data(), data.size()),
+               std::logic_error);
+
+  EXPECT_THROW(Checkpoint::load(checkpoint_path("akss_missing.ckpt")),
+               std::runtime_error);
+}
+
+TEST(Checkpoint, Replace)
+{
+  const std::string path = checkpoint_path("akss_replace.ckpt");
+  SpectralSequence longer = example_sequence();
+  longer.set_group(TrigradedIndex(5, 0, 0), 2, AbelianGroup(1, 0));
+
+  Checkpoint::save(longer, path);
+  Checkpoint::save(example_sequence(), path);
+
+  EXPECT_EQ(Checkpoint::serialize(example_sequence()),
+            Checkpoint::serialize(Checkpoint::load(path)));
+  EXPECT_FALSE(std::ifstream(path + ".tmp").good());
+
+  std::remove(path.c_str());
+}
+
+TEST(Checkpoint, Writer)
+{
+  const std::string path = checkpoint_path("akss_writer.ckpt");
+  SpectralSequence spec = example_sequence();
+
+  {
+    CheckpointWriter writer(path, std::chrono::seconds(3600));
+    EXPECT_FALSE(writer.save_if_due(spec));
+
+    writer.save(spec);
+    writer.wait();
+    EXPECT_EQ(Checkpoint::serialize(spec),
+              Checkpoint::serialize(Checkpoint::load(path)));
+
+    spec.set_group(TrigradedIndex(5, 0, 0), 2, AbelianGroup(1, 0));
+    writer.save(spec);
+  }
+
+  EXPECT_EQ(Checkpoint::serialize(spec),
+            Checkpoint::serialize(Checkpoint::load(path)));
+
+  CheckpointWriter failing(checkpoint_path("missing/akss_writer.ckpt"),
+                           std::chrono::seconds(0));
+  EXPECT_TRUE(failing.save_if_due(spec));
+  EXPECT_THROW(failing.wait(), std::runtime_error);
+
+  std::remove(path.c_str());
+}
@@ -0,0 +1,66 @@
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "../src/counters.h"
+#include "../src/matrix.h"
+#include "../src/morphisms.h"
+
+TEST(Counters, Smith)
+{
+  reset_counters();
+
+  AbelianGroup Y(0, 2);
+  Y(0) = 2;
+  Y(1) = 1;
+  MatrixQ f = {{3}, {1}};
+
+  MatrixQList to_Y = {MatrixQ::identity(2)};
+  compute_cokernel(3, f, Y, ref(to_Y), MatrixQRefList());
+
+  const CounterValues totals = counter_totals();
+  const std::vector<CounterCall> calls = counter_calls();
+
+#ifdef AKSS_COUNTERS
+  EXPECT_EQ(2, totals[static_cast<std::size_t>(Counter::PivotSteps)]);
+  EXPECT_LT(0, totals[static_cast<std::size_t>(Counter::PValQ)]);
+  EXPECT_LT(0, totals[static_cast<std::size_t>(Counter::RowAdd)]);
+  EXPECT_LT(0, totals[static_cast<std::size_t>(Counter::GmpBytes)]);
+
+  ASSERT_LE(2, calls.size());
+  EXPECT_EQ("compute_cokernel", calls.back().name);
+  EXPECT_EQ(totals[static_cast<std::size_t>(Counter::PivotSteps)],
+            calls.back().counts[static_cast<std::size_t>(Counter::PivotSteps)]);
+
+  std::ostringstream dump;
+  dump_counters(dump);
+  EXPECT_NE(std::string::npos, dump.str().find("compute_cokernel (1 calls)"));
+#else
+  for (const std::uint64_t value : totals) EXPECT_EQ(0, value);
+  EXPECT_TRUE(calls.empty());
+#endif
+
+  reset_counters();
+  EXPECT_EQ(0, counter_totals()[static_cast<std::size_t>(Counter::RowAdd)]);
+  EXPECT_STREQ("row_add", counter_name(Counter::RowAdd));
+}
+
+TEST(Counters, History)
+{
+  reset_counters();
+
+  for (std::size_t k = 0; k < COUNTER_HISTORY + 10; ++k) {
+    CounterScope scope(k % 2 ? "odd" : "even");
+  }
+
+  EXPECT_EQ(COUNTER_HISTORY, counter_calls().size());
+  EXPECT_EQ("odd", counter_calls().back().name);
+
+  std::ostringstream dump;
+  dump_counters(dump);
+  EXPECT_NE(std::string::npos,
+            dump.str().find("odd (" + std::to_string(COUNTER_HISTORY / 2 + 5) +
+                            " calls)"));
+
+  reset_counters();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+#include "../src/matrix.h"
+
+// Linear congruential generator for test inputs. Unlike the distributions of
+// the standard library, it gives the same inputs on every platform.
+class TestRng
+{
+ public:
+  explicit TestRng(const std::size_t seed) : state_(seed)
+  {
+  }
+
+  // Next value in [0, 2^31).
+  std::size_t operator()()
+  {
+    state_ = (state_ * 1103515245 + 12345) % 2147483648;
+    return state_;
+  }
+
+ private:
+  std::size_t state_;
+};
+
+// Matrix with about one in every `sparsity` entries set to an integer in
+// [-bound, bound].
+inline MatrixQ sparse_test_matrix(const std::size_t seed,
+                                  const std::size_t height,
+                                  const std::size_t width,
+                                  const std::size_t sparsity,
+                                  const long bound)
+{
+  TestRng rng(seed);
+  MatrixQ f(height, width);
+  for (std::size_t i = 0; i < height; ++i) {
+    for (std::size_t j = 0; j < width; ++j) {
+      const std::size_t r = rng();
+      if (r % sparsity == 0)
+        f(i, j) = long(r % std::size_t(2 * bound + 1)) - bound;
+    }
+  }
+
+  return f;
+}
@@ -0,0 +1,142 @@
+#include <thread>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/gmp_arena.h"
+#include "../src/morphisms.h"
+#include "../src/smith.h"
+
+namespace {
+
+const void* limbs(const mpz_class& x)
+{
+  return x.get_mpz_t()->_mp_d;
+}
+
+void expect_same(const GroupWithMorphisms& expected,
+                 const GroupWithMorphisms& actual)
+{
+  EXPECT_EQ(expected.group.free_rank(), actual.group.free_rank());
+  ASSERT_EQ(expected.group.tor_rank(), actual.group.tor_rank());
+  for (std::size_t i = 0; i < expected.group.tor_rank(); ++i) {
+    EXPECT_EQ(expected.group(i), actual.group(i));
+  }
+
+  ASSERT_EQ(expected.maps_to.size(), actual.maps_to.size());
+  for (std::size_t k = 0; k < expected.maps_to.size(); ++k) {
+    EXPECT_TRUE(expected.maps_to[k] == actual.maps_to[k]);
+  }
+  ASSERT_EQ(expected.maps_from.size(), actual.maps_from.size());
+  for (std::size_t k = 0; k < expected.maps_from.size(); ++k) {
+    EXPECT_TRUE(expected.maps_from[k] == actual.maps_from[k]);
+  }
+}
+
+}  // namespace
+
+TEST(GmpArena, Scope)
+{
+  GmpArena arena;
+  mpz_class outside = 1;
+  outside <<= 200;
+
+  {
+    GmpArena::Scope scope(arena);
+    mpz_class inside = outside + 1;
+    EXPECT_TRUE(arena.owns(limbs(inside)));
+    EXPECT_FALSE(arena.owns(limbs(outside)));
+
+    GmpArena::Suspend suspend;
+    mpz_class copy = inside;
+    EXPECT_FALSE(arena.owns(limbs(copy)));
+    EXPECT_EQ(outside + 1, copy);
+  }
+
+  mpz_class after = outside + 1;
+  EXPECT_FALSE(arena.owns(limbs(after)));
+  EXPECT_EQ(std::size_t(1) << 20, arena.reserved());
+}
+
+TEST(GmpArena, Reuse)
+{
+  GmpArena arena;
+  GmpArena::Scope scope(arena);
+
+  mpz_class x = 1;
+  for (std::size_t k = 0; k < 100000; ++k) {
+    mpz_class y = x << 300;
+    x = (y >> 300) + k;
+  }
+
+  EXPECT_EQ(mpz_class("4999950001"), x);
+  EXPECT_EQ(std::size_t(1) << 20, arena.reserved());
+}
+
+TEST(GmpArena, Grow)
+{
+  GmpArena arena;
+  GmpArena::Scope scope(arena);
+
+  mpz_class x = 3;
+  for (std::size_t k = 0; k < 20; ++k) x *= x;
+
+  EXPECT_TRUE(arena.owns(limbs(x)) || mpz_size(x.get_mpz_t()) > 4096);
+  EXPECT_EQ(0, mpz_fdiv_ui(x.get_mpz_t(), 3));
+}
+
+TEST(GmpArena, OtherThread)
+{
+  GmpArena arena;
+  mpz_class x;
+  {
+    GmpArena::Scope scope(arena);
+    x = 1;
+    x <<= 100;
+  }
+  ASSERT_TRUE(arena.owns(limbs(x)));
+
+  std::thread other([&x]() { x <<= 1000; });
+  other.join();
+
+  EXPECT_FALSE(arena.owns(limbs(x)));
+  EXPECT_EQ(mpz_class(1) << 1100, x);
+}
+
+TEST(GmpArena, Morphisms)
+{
+  AbelianGroup X(1, 2);
+  X(0) = 2;
+  X(1) = 3;
+
+  AbelianGroup Y(0, 3);
+  Y(0) = 2;
+  Y(1) = 1;
+  Y(2) = 3;
+
+  MatrixQ f = {{3, 1, 0}, {0, 0, 1}, {9, 3, 3}};
+  MatrixQList from_X = {MatrixQ::identity(3)};
+  MatrixQList to_Y = {MatrixQ::identity(3)};
+
+  const KernelAndCokernel expected = compute_kernel_cokernel(
+      3, f, X, Y, MatrixQRefList(), ref(from_X), ref(to_Y), MatrixQRefList());
+
+  set_morphism_arenas(true);
+  for (const std::size_t threads : {std::size_t(1), std::size_t(4)}) {
+    set_smith_threads(threads);
+    KernelAndCokernel KC = compute_kernel_cokernel(
+        3, f, X, Y, MatrixQRefList(), ref(from_X), ref(to_Y), MatrixQRefList());
+    GroupWithMorphisms I = compute_image(3, f, X, Y);
+
+    // Both results have to survive the arenas used by later calls.
+    compute_kernel_cokernel(3, f, X, Y, MatrixQRefList(), ref(from_X),
+                            ref(to_Y), MatrixQRefList());
+
+    expect_same(expected.kernel, KC.kernel);
+    expect_same(expected.cokernel, KC.cokernel);
+    EXPECT_TRUE(morphism_equal(3, I.maps_from[0] * I.maps_to[0], f, Y));
+  }
+  set_smith_threads(1);
+  set_morphism_arenas(false);
+}
@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "../src/matrix_reader.h"
+
+namespace {
+
+std::string write_file(const std::string& name, const std::string& contents)
+{
+  const std::string path = ::testing::TempDir() + name;
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return path;
+}
+
+}  // namespace
+
+TEST(MatrixReader, MatrixMarket)
+{
+  const std::string path = write_file(
+      "akss_reader.mtx",
+      "%%MatrixMarket matrix coordinate integer general\n"
+      "% a comment\n"
+      "%\n"
+      "3 4 4\n"
+      "1 1 2\n"
+      "3 2 -7\n"
+      "2 4 123456789012345678901234567890\n"
+      "1 3 -98765432109876543210\n");
+
+  MatrixQ f = read_matrix<mpq_class>(path);
+  MatrixQ g(3, 4);
+  g(0, 0) = 2;
+  g(2, 1) = -7;
+  g(1, 3) = mpz_class("123456789012345678901234567890");
+  g(0, 2) = mpz_class("-98765432109876543210");
+  EXPECT_EQ(g, f);
+
+  SparseMatrixQ f_sparse = read_sparse_matrix<mpq_class>(path);
+  EXPECT_EQ(4, f_sparse.nonzeros());
+  for (std::size_t i = 0; i < g.height(); ++i) {
+    for (std::size_t j = 0; j < g.width(); ++j) {
+      EXPECT_EQ(g(i, j), f_sparse(i, j));
+    }
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST(MatrixReader, Symmetric)
+{
+  const std::string path =
+      write_file("akss_reader_symmetric.mtx",
+                 "%%MatrixMarket matrix coordinate pattern symmetric\r\n"
+                 "3 3 2\r\n"
+                 "1 1\r\n"
+                 "3 1\r\n");
+
+  EXPECT_EQ(MatrixQ({{1, 0, 1}, {0, 0, 0}, {1, 0, 0}}),
+            read_matrix<mpq_class>(path));
+
+  const std::string skew_path =
+      write_file("akss_reader_skew.mtx",
+                 "%%MatrixMarket matrix coordinate integer skew-symmetric\n"
+                 "2 2 1\n"
+                 "2 1 5\n");
+
+  EXPECT_EQ(MatrixQ({{0, -5}, {5, 0}}), read_matrix<mpq_class>(skew_path));
+
+  std::remove(path.c_str());
+  std::remove(skew_path.c_str());
+}
+
+TEST(MatrixReader, SMS)
+{
+  const std::string path = write_file("akss_reader.sms",
+                                      "2 3 M\n"
+                                      "1 2 3\n"
+                                      "2 3 -1\n"
+                                      "0 0 0\n");
+
+  EXPECT_EQ(MatrixQ({{0, 3, 0}, {0, 0, -1}}), read_matrix<mpq_class>(path));
+
+  std::remove(path.c_str());
+}
+
+TEST(MatrixReader, Invalid)
+{
+  const std::string range_path = write_file(
+      "akss_reader_range.mtx",
+      "%%MatrixMarket matrix coordinate integer general\n2 2 1\n3 1 1\n");
+  EXPECT_THROW(read_matrix<mpq_class>(range_path), std::logic_error);
+
+  const std::string short_path = write_file(
+      "akss_reader_short.mtx",
+      "%%MatrixMarket matrix coordinate integer general\n2 2 2\n1 1 1\n");
+  EXPECT_THROW(read_matrix<mpq_class>(short_path), std::logic_error);
+
+  const std::string real_path = write_file(
+      "akss_reader_real.mtx",
+      "%%MatrixMarket matrix coordinate real general\n1 1 1\n1 1 0.5\n");
+  EXPECT_THROW(read_matrix<mpq_class>(real_path), std::logic_error);
+
+  EXPECT_THROW(read_matrix<mpq_class>(::testing::TempDir() + "akss_missing"),
+               std::runtime_error);
+
+  std::remove(range_path.c_str());
+  std::remove(short_path.c_str());
+  std::remove(real_path.c_str());
+}
@@ -4,6 +4,7 @@
 #include "gtest/gtest.h"
 
 #include "../src/matrix.h"
+#include "generators.h"
 
 TEST(Matrix, Properties)
 {
@@ -134,6 +135,174 @@ TEST(Matrix, Composition)
   EXPECT_EQ(C_ref, C);
 }
 
+TEST(Matrix, RationalProduct)
+{
+  // Odd dimensions, so that Strassen's algorithm has to pad its blocks.
+  MatrixQ A(13, 9);
+  Matrix<mpq_class, ColMajor> B(9, 11);
+  TestRng rng(3);
+  for (std::size_t i = 0; i < 13; ++i) {
+    for (std::size_t j = 0; j < 11; ++j) {
+      const std::size_t r = rng();
+      if (j < 9 && r % 3) A(i, j) = mpq_class(long(r % 17) - 8) / (r % 5 + 1);
+      if (i < 9 && r % 4)
+        B(i, j) = mpq_class(long(r % 23) - 11) / (r % 7 + 1);
+    }
+  }
+
+  MatrixQ C_ref(13, 11);
+  for (std::size_t i = 0; i < 13; ++i) {
+    for (std::size_t j = 0; j < 11; ++j) {
+      for (std::size_t k = 0; k < 9; ++k) C_ref(i, j) += A(i, k) * B(k, j);
+    }
+  }
+
+  EXPECT_EQ(C_ref, A * B);
+
+  const std::size_t threshold = strassen_threshold();
+  set_strassen_threshold(3);
+  set_matrix_threads(3);
+  EXPECT_EQ(3, matrix_threads());
+  EXPECT_EQ(C_ref, A * B);
+  set_matrix_threads(1);
+  set_strassen_threshold(threshold);
+}
+
+TEST(Matrix, ColMajor)
+{
+  const MatrixQ A = {{1, 2, 3}, {4, 5, 6}};
+  Matrix<mpq_class, ColMajor> B = {{1, 2, 3}, {4, 5, 6}};
+
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(6, B(1, 2));
+
+  B.col_add(0, 2, 2_mpq).row_swap(0, 1).col_mul(1, 3_mpq);
+  MatrixQ C = A;
+  C.col_add(0, 2, 2_mpq).row_swap(0, 1).col_mul(1, 3_mpq);
+  EXPECT_EQ(C, B);
+
+  const MatrixQ D = {{1, 0}, {0, 1}, {1, 1}};
+  const Matrix<mpq_class, ColMajor> E = {{1, 0}, {0, 1}, {1, 1}};
+  EXPECT_EQ(C * D, B * E);
+}
+
+TEST(Matrix, LayoutConversion)
+{
+  MatrixQ A = {{1, 2}, {3, 4}, {5, 6}};
+  Matrix<mpq_class, ColMajor> B(std::move(MatrixQ(A)));
+  EXPECT_EQ(A, B);
+
+  Matrix<mpq_class, ColMajor> C(3, 3);
+  C(0, 1, 3, 2) = A;
+  EXPECT_EQ(A, C(0, 1, 3, 2));
+  EXPECT_EQ(0, C(2, 0));
+
+  MatrixRefList<mpq_class> refs = {A};
+  MatrixList<mpq_class, ColMajor> list = deref<ColMajor>(refs);
+  ASSERT_EQ(1, list.size());
+  EXPECT_EQ(A, list[0]);
+}
+
+TEST(Matrix, ConstReference)
+{
+  MatrixQ A = {{1, 2, 3}, {4, 5, 6}};
+  const MatrixQ& B = A;
+  const MatrixExpression<mpq_class, MatrixQ>& C = A;
+
+  EXPECT_EQ(&A(1, 2), &B(1, 2));
+  EXPECT_EQ(&A(1, 2), &C(1, 2));
+  EXPECT_EQ(&A(1, 2), &transpose(A)(2, 1));
+}
+
+TEST(Matrix, CopyOnWrite)
+{
+  const MatrixQ A = {{1, 2}, {3, 4}};
+  MatrixQ B = A;
+  MatrixQ C = A;
+
+  EXPECT_EQ(&A(0, 0), &static_cast<const MatrixQ&>(B)(0, 0));
+
+  B.row_add(0, 1, 1_mpq);
+  C(1, 1) = 5;
+  EXPECT_EQ(MatrixQ({{1, 2}, {3, 4}}), A);
+  EXPECT_EQ(MatrixQ({{1, 2}, {4, 6}}), B);
+  EXPECT_EQ(MatrixQ({{1, 2}, {3, 5}}), C);
+  EXPECT_NE(&A(0, 0), &static_cast<const MatrixQ&>(B)(0, 0));
+
+  MatrixQ D = A;
+  D.detach();
+  EXPECT_NE(&A(0, 0), &static_cast<const MatrixQ&>(D)(0, 0));
+
+  MatrixQ E = A;
+  Matrix<mpq_class, ColMajor> F(std::move(E));
+  EXPECT_EQ(A, F);
+  EXPECT_EQ(MatrixQ({{1, 2}, {3, 4}}), A);
+
+  // Copying a slice only reads the matrix it is taken from.
+  MatrixQ G = A;
+  const MatrixQ H(G(1, 0, 1, 2));
+  EXPECT_EQ(MatrixQ({{3, 4}}), H);
+  EXPECT_EQ(&A(0, 0), &static_cast<const MatrixQ&>(G)(0, 0));
+
+  MatrixQ I = MatrixQ::identity(3);
+  const MatrixQ J(I(0, 1, 2, 2));
+  EXPECT_EQ(MatrixQ({{0, 0}, {1, 0}}), J);
+  EXPECT_TRUE(I.compact());
+}
+
+TEST(Matrix, Compact)
+{
+  MatrixQ A = MatrixQ::identity(3);
+  MatrixQ B = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  ASSERT_TRUE(A.compact());
+
+  A.row_swap(0, 2).col_mul(1, 3_mpq).row_mul(0, 2_mpq).col_swap(0, 1);
+  B.row_swap(0, 2).col_mul(1, 3_mpq).row_mul(0, 2_mpq).col_swap(0, 1);
+  EXPECT_TRUE(A.compact());
+  EXPECT_EQ(B, A);
+  EXPECT_THROW(A.row(0), std::logic_error);
+
+  // Products with a compact factor, and of two compact factors.
+  const MatrixQ C = {{1, 2, 3}, {4, 5, 6}};
+  const MatrixQ D = {{1, 4}, {2, 5}, {3, 6}};
+  EXPECT_EQ(C * B, C * A);
+  EXPECT_EQ(B * D, A * D);
+  EXPECT_EQ(B * B, A * A);
+  EXPECT_TRUE((A * A).compact());
+
+  // Copies share the compact entries until one of them is modified.
+  MatrixQ F = A;
+  F.row_add(0, 1, 1_mpq);
+  B.row_add(0, 1, 1_mpq);
+  EXPECT_FALSE(F.compact());
+  EXPECT_TRUE(A.compact());
+  EXPECT_EQ(B, F);
+
+  Matrix<mpq_class, ColMajor> E(std::move(A));
+  EXPECT_TRUE(E.compact());
+  E.expand();
+  EXPECT_FALSE(E.compact());
+  EXPECT_EQ(MatrixQ(B).row_add(0, 1, -1_mpq), E);
+}
+
+TEST(Matrix, Views)
+{
+  const MatrixQ A = {{1, 2, 3}, {4, 5, 6}};
+  const Matrix<mpq_class, ColMajor> B = {{1, 2, 3}, {4, 5, 6}};
+
+  EXPECT_EQ(MatrixQ({{4, 5, 6}}), A.row(1));
+  EXPECT_EQ(MatrixQ({{4, 5, 6}}), B.row(1));
+  EXPECT_EQ(MatrixQ({{2}, {5}}), A.col(1));
+  EXPECT_EQ(MatrixQ({{2}, {5}}), B.col(1));
+  EXPECT_EQ(3, A.row(0).size());
+  EXPECT_EQ(6, B.row(1)[2]);
+  EXPECT_EQ(5, B.col(1)[1]);
+
+  EXPECT_EQ(MatrixQ({{1, 4}, {2, 5}, {3, 6}}), transpose(A));
+  EXPECT_EQ(A, transpose(transpose(B)));
+  EXPECT_EQ(MatrixQ({{2, 5}}), transpose(A.col(1)));
+}
+
 TEST(MatrixSlice, DimensionMismatch)
 {
   MatrixQ A(2, 2);
@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/mod_kernels.h"
+
+namespace {
+
+std::vector<std::uint64_t> residues(const std::size_t n, const std::uint64_t m,
+                                    std::uint64_t& seed)
+{
+  std::vector<std::uint64_t> x(n);
+  for (std::uint64_t& r : x) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    r = (seed >> 16) % m;
+  }
+  return x;
+}
+
+}  // namespace
+
+TEST(ModKernels, MatchScalar)
+{
+  const ModKernels best = mod_kernels();
+  const std::uint64_t moduli[] = {2, 3, 243, 65521, 4294967291};
+  std::uint64_t seed = 1;
+
+  for (const ModKernels kernels :
+       {ModKernels::Scalar, ModKernels::Avx2, ModKernels::Avx512}) {
+    if (!set_mod_kernels(kernels)) continue;
+
+    for (const std::uint64_t m : moduli) {
+      // Lengths that leave a scalar tail behind the vector loops.
+      const std::size_t n = 37;
+      const std::vector<std::uint64_t> x = residues(n, m, seed);
+      std::vector<std::uint64_t> y = residues(n, m, seed);
+      std::vector<std::uint64_t> z = x;
+      const std::uint64_t lambda = m - 1;
+
+      std::vector<std::uint64_t> y_expected = y;
+      std::vector<std::uint64_t> z_expected = z;
+      for (std::size_t k = 0; k < n; ++k) {
+        y_expected[k] = (y[k] + lambda * x[k] % m) % m;
+        z_expected[k] = lambda * z[k] % m;
+      }
+
+      mod_add_mul(y.data(), x.data(), n, lambda, m);
+      mod_mul(z.data(), n, lambda, m);
+
+      EXPECT_EQ(y_expected, y);
+      EXPECT_EQ(z_expected, z);
+    }
+  }
+
+  EXPECT_TRUE(set_mod_kernels(best));
+}
@@ -2,6 +2,19 @@
 
 #include "../src/matrix.h"
 #include "../src/morphisms.h"
+#include "../src/p_local.h"
+#include "generators.h"
+
+namespace {
+
+void expect_same_group(const AbelianGroup& G, const AbelianGroup& H)
+{
+  EXPECT_EQ(G.free_rank(), H.free_rank());
+  ASSERT_EQ(G.tor_rank(), H.tor_rank());
+  for (std::size_t i = 0; i < G.tor_rank(); ++i) EXPECT_EQ(G(i), H(i));
+}
+
+}  // namespace
 
 TEST(Cokernel, Diagonal)
 {
@@ -18,6 +31,45 @@ TEST(Cokernel, Diagonal)
   EXPECT_EQ(1, C.group(0));
 }
 
+TEST(Cokernel, Torsion)
+{
+  AbelianGroup Y(0, 2);
+  Y(0) = 2;
+  Y(1) = 1;
+  MatrixQ f = {{3}, {1}};
+
+  MatrixQList to_Y = {MatrixQ::identity(2)};
+  GroupWithMorphisms C =
+      compute_cokernel(3, f, Y, ref(to_Y), MatrixQRefList());
+
+  EXPECT_EQ(0, C.group.free_rank());
+  ASSERT_EQ(1, C.group.tor_rank());
+  EXPECT_EQ(2, C.group(0));
+  EXPECT_TRUE(morphism_zero(3, C.maps_to[0] * f, C.group));
+  EXPECT_FALSE(morphism_zero(3, C.maps_to[0], C.group));
+}
+
+TEST(Cokernel, Sparse)
+{
+  AbelianGroup Y(1, 2);
+  Y(0) = 2;
+  Y(1) = 1;
+  MatrixQ f = {{3, 0, 1}, {1, 0, 0}, {0, 0, 9}};
+
+  MatrixQList to_Y = {MatrixQ::identity(3)};
+  GroupWithMorphisms C =
+      compute_cokernel(3, f, Y, ref(to_Y), MatrixQRefList());
+  GroupWithMorphisms C_sparse =
+      compute_cokernel(3, SparseMatrixQ(f), Y, ref(to_Y), MatrixQRefList());
+
+  EXPECT_EQ(C.group.free_rank(), C_sparse.group.free_rank());
+  ASSERT_EQ(C.group.tor_rank(), C_sparse.group.tor_rank());
+  for (std::size_t i = 0; i < C.group.tor_rank(); ++i) {
+    EXPECT_EQ(C.group(i), C_sparse.group(i));
+  }
+  EXPECT_TRUE(morphism_zero(3, C_sparse.maps_to[0] * f, C_sparse.group));
+}
+
 TEST(Kernel, Diagonal)
 {
   AbelianGroup X(0, 2);
@@ -45,6 +97,145 @@ TEST(Kernel, Diagonal)
 
 }
 
+TEST(KernelCokernel, Shared)
+{
+  AbelianGroup X(1, 2);
+  X(0) = 2;
+  X(1) = 3;
+
+  AbelianGroup Y(0, 3);
+  Y(0) = 2;
+  Y(1) = 1;
+  Y(2) = 3;
+
+  MatrixQ f = {{3, 1, 0}, {0, 0, 1}, {9, 3, 3}};
+
+  MatrixQList from_X = {MatrixQ::identity(3)};
+  MatrixQList to_Y = {MatrixQ::identity(3)};
+
+  GroupWithMorphisms K =
+      compute_kernel(3, f, X, Y, MatrixQRefList(), ref(from_X));
+  GroupWithMorphisms C =
+      compute_cokernel(3, f, Y, ref(to_Y), MatrixQRefList());
+  KernelAndCokernel KC = compute_kernel_cokernel(
+      3, f, X, Y, MatrixQRefList(), ref(from_X), ref(to_Y), MatrixQRefList());
+  KernelAndCokernel KC_sparse =
+      compute_kernel_cokernel(3, SparseMatrixQ(f), X, Y, MatrixQRefList(),
+                              ref(from_X), ref(to_Y), MatrixQRefList());
+
+  for (const KernelAndCokernel& result : {KC, KC_sparse}) {
+    EXPECT_EQ(K.group.free_rank(), result.kernel.group.free_rank());
+    ASSERT_EQ(K.group.tor_rank(), result.kernel.group.tor_rank());
+    for (std::size_t i = 0; i < K.group.tor_rank(); ++i) {
+      EXPECT_EQ(K.group(i), result.kernel.group(i));
+    }
+    EXPECT_TRUE(
+        morphism_zero(3, f * result.kernel.maps_from[0], Y));
+
+    EXPECT_EQ(C.group.free_rank(), result.cokernel.group.free_rank());
+    ASSERT_EQ(C.group.tor_rank(), result.cokernel.group.tor_rank());
+    for (std::size_t i = 0; i < C.group.tor_rank(); ++i) {
+      EXPECT_EQ(C.group(i), result.cokernel.group(i));
+    }
+    EXPECT_TRUE(
+        morphism_zero(3, result.cokernel.maps_to[0] * f, result.cokernel.group));
+  }
+}
+
+TEST(KernelCokernel, WordReduction)
+{
+  TestRng rng(11);
+  for (const std::size_t p :
+       {std::size_t(2), std::size_t(3), std::size_t(5)}) {
+    for (std::size_t round = 0; round < 10; ++round) {
+      AbelianGroup X(0, 2 + rng() % 5);
+      AbelianGroup Y(0, 2 + rng() % 5);
+      for (std::size_t j = 0; j < X.tor_rank(); ++j) X(j) = 1 + rng() % 3;
+      for (std::size_t i = 0; i < Y.tor_rank(); ++i) Y(i) = 1 + rng() % 3;
+
+      MatrixQ f(Y.rank(), X.rank());
+      for (std::size_t i = 0; i < Y.rank(); ++i) {
+        for (std::size_t j = 0; j < X.rank(); ++j) {
+          f(i, j) = long(rng() % 19) - 9;
+          if (Y(i) > X(j)) f(i, j) *= p_pow_z(p, Y(i) - X(j));
+        }
+      }
+
+      MatrixQList from_X = {MatrixQ::identity(X.rank())};
+      MatrixQList to_Y = {MatrixQ::identity(Y.rank())};
+
+      std::vector<GroupWithMorphisms> kernels, cokernels, images;
+      for (const bool words : {true, false}) {
+        set_morphism_word_reduction(words);
+        kernels.push_back(
+            compute_kernel(p, f, X, Y, MatrixQRefList(), ref(from_X)));
+        cokernels.push_back(
+            compute_cokernel(p, f, Y, ref(to_Y), MatrixQRefList()));
+        images.push_back(compute_image(p, f, X, Y));
+      }
+      set_morphism_word_reduction(true);
+
+      expect_same_group(kernels[0].group, kernels[1].group);
+      expect_same_group(cokernels[0].group, cokernels[1].group);
+      expect_same_group(images[0].group, images[1].group);
+      for (std::size_t k = 0; k < 2; ++k) {
+        EXPECT_TRUE(morphism_zero(p, f * kernels[k].maps_from[0], Y));
+        EXPECT_TRUE(morphism_zero(p, cokernels[k].maps_to[0] * f,
+                                  cokernels[k].group));
+        EXPECT_TRUE(morphism_equal(
+            p, images[k].maps_from[0] * images[k].maps_to[0], f, Y));
+      }
+    }
+  }
+}
+
+TEST(KernelCokernel, SparseRandom)
+{
+  TestRng rng(5);
+  for (const std::size_t p : {std::size_t(2), std::size_t(3)}) {
+    for (std::size_t round = 0; round < 10; ++round) {
+      AbelianGroup X(rng() % 3, 2 + rng() % 6);
+      AbelianGroup Y(rng() % 3, 2 + rng() % 6);
+      for (std::size_t j = 0; j < X.tor_rank(); ++j) X(j) = 1 + rng() % 3;
+      for (std::size_t i = 0; i < Y.tor_rank(); ++i) Y(i) = 1 + rng() % 3;
+
+      MatrixQ f(Y.rank(), X.rank());
+      for (std::size_t i = 0; i < Y.rank(); ++i) {
+        for (std::size_t j = 0; j < X.rank(); ++j) {
+          if (rng() % 3 != 0) continue;
+          if (i >= Y.tor_rank() && j < X.tor_rank()) continue;
+          f(i, j) = long(rng() % 19) - 9;
+          if (i < Y.tor_rank() && j < X.tor_rank() && Y(i) > X(j))
+            f(i, j) *= p_pow_z(p, Y(i) - X(j));
+        }
+      }
+
+      MatrixQList from_X = {MatrixQ::identity(X.rank())};
+      MatrixQList to_Y = {MatrixQ::identity(Y.rank())};
+      KernelAndCokernel KC = compute_kernel_cokernel(
+          p, f, X, Y, MatrixQRefList(), ref(from_X), ref(to_Y),
+          MatrixQRefList());
+
+      // The inclusion of the kernel lands in it, so the sparse kernel has to
+      // factor it through its own inclusion.
+      MatrixQList to_X;
+      to_X.emplace_back(KC.kernel.maps_from[0]);
+      KernelAndCokernel KC_sparse = compute_kernel_cokernel(
+          p, SparseMatrixQ(f), X, Y, ref(to_X), ref(from_X), ref(to_Y),
+          MatrixQRefList());
+
+      expect_same_group(KC.kernel.group, KC_sparse.kernel.group);
+      expect_same_group(KC.cokernel.group, KC_sparse.cokernel.group);
+      EXPECT_TRUE(morphism_zero(p, f * KC_sparse.kernel.maps_from[0], Y));
+      EXPECT_TRUE(morphism_equal(
+          p, KC_sparse.kernel.maps_from[0] * KC_sparse.kernel.maps_to[0],
+          to_X[0], X));
+      EXPECT_TRUE(morphism_zero(p, KC_sparse.cokernel.maps_to[0] * f,
+                                KC_sparse.cokernel.group));
+    }
+  }
+}
+
 TEST(Morphism, Equal)
 {
 	MatrixQ f = {{2,1},{5,2}};
@@ -66,23 +257,132 @@ TEST(Morphism, Zero) {
 
 }
 
+TEST(Morphism, Reduce)
+{
+  AbelianGroup Y(1, 2);
+  Y(0) = 2;
+  Y(1) = 1;
+
+  MatrixQ f = {{-1, mpq_class(1, 2)}, {4, mpq_class(1, 3)}, {-5, 10}};
+  MatrixQ g = f;
+  reduce_morphism(3, g, Y);
+
+  // Entries which are not 3-integral and free rows are kept.
+  MatrixQ expected = {{8, 5}, {1, mpq_class(1, 3)}, {-5, 10}};
+  EXPECT_EQ(expected, g);
+  EXPECT_TRUE(morphism_equal(3, f, g, Y));
+}
+
+TEST(Image, Diagonal)
+{
+  AbelianGroup X(0, 2);
+  X(0) = 2;
+  X(1) = 2;
+
+  AbelianGroup Y(0, 2);
+  Y(0) = 2;
+  Y(1) = 2;
+
+  MatrixQ f = {{0, 6}, {0, 0}};
+
+  GroupWithMorphisms I = compute_image(3, f, X, Y);
+
+  EXPECT_EQ(0, I.group.free_rank());
+  ASSERT_EQ(1, I.group.tor_rank());
+  EXPECT_EQ(1, I.group(0));
+  EXPECT_TRUE(morphism_equal(3, I.maps_from[0] * I.maps_to[0], f, Y));
+}
+
+TEST(Image, Mixed)
+{
+  AbelianGroup X(1, 2);
+  X(0) = 1;
+  X(1) = 3;
+
+  AbelianGroup Y(0, 3);
+  Y(0) = 2;
+  Y(1) = 3;
+  Y(2) = 1;
+
+  MatrixQ f = {{3, 0, 1}, {0, 9, 3}, {0, 1, 1}};
+
+  GroupWithMorphisms I = compute_image(3, f, X, Y);
+
+  // The image has 81 elements, 27 of which are killed by 3.
+  EXPECT_EQ(0, I.group.free_rank());
+  ASSERT_EQ(3, I.group.tor_rank());
+  EXPECT_EQ(4, I.group(0) + I.group(1) + I.group(2));
+  EXPECT_TRUE(morphism_equal(3, I.maps_from[0] * I.maps_to[0], f, Y));
+
+  MatrixQ rel_X = {{3, 0}, {0, 27}, {0, 0}};
+  EXPECT_TRUE(morphism_zero(3, I.maps_to[0] * rel_X, I.group));
+}
+
+TEST(Image, Free)
+{
+  AbelianGroup X(2, 0);
+  AbelianGroup Y(1, 1);
+  Y(0) = 1;
+
+  MatrixQ f = {{1, 0}, {0, 3}};
+
+  GroupWithMorphisms I = compute_image(3, f, X, Y);
+
+  EXPECT_EQ(1, I.group.free_rank());
+  ASSERT_EQ(1, I.group.tor_rank());
+  EXPECT_EQ(1, I.group(0));
+  EXPECT_TRUE(morphism_equal(3, I.maps_from[0] * I.maps_to[0], f, Y));
+}
+
+TEST(Image, FreeAndTorsion)
+{
+  AbelianGroup X(2, 1);
+  X(0) = 2;
+
+  AbelianGroup Y(2, 2);
+  Y(0) = 1;
+  Y(1) = 2;
+
+  // The free generators of X map to (1, 0, 3, 0) and (0, 1, 3, 0), whose
+  // difference lies in the torsion of Y.
+  MatrixQ f = {{0, 1, 0}, {1, 0, 1}, {0, 3, 3}, {0, 0, 0}};
+
+  GroupWithMorphisms I = compute_image(3, f, X, Y);
 
-//TEST(Image, Diagonal) {
-//	AbelianGroup X(0,2);
-//	X(0) = 2;
-//	X(1) = 2;
-//
-//	AbelianGroup Y(0,2);
-//	Y(0) = 2;
-//	Y(1) = 2;
-//
-//	MatrixQ f = {{0,6},{0,0}};
-//
-//	MatrixQList to_I;
-//	MatrixQList from_I;
-//	AbelianGroup I = compute_image(3,f,X,Y,to_I, from_I);
-//
-//	EXPECT_EQ(0,I.free_rank());
-//	ASSERT_EQ(1,I.tor_rank());
-//	EXPECT_EQ(1,I(0));
-//}
+  EXPECT_EQ(1, I.group.free_rank());
+  ASSERT_EQ(2, I.group.tor_rank());
+  EXPECT_EQ(3, I.group(0) + I.group(1));
+  EXPECT_TRUE(morphism_equal(3, I.maps_from[0] * I.maps_to[0], f, Y));
+
+  MatrixQ rel_X = {{9}, {0}, {0}};
+  EXPECT_TRUE(morphism_zero(3, I.maps_to[0] * rel_X, I.group));
+}
+
+TEST(Image, GroupOnly)
+{
+  AbelianGroup X(1, 2);
+  X(0) = 1;
+  X(1) = 3;
+
+  AbelianGroup Y(0, 3);
+  Y(0) = 2;
+  Y(1) = 3;
+  Y(2) = 1;
+
+  MatrixQ f = {{3, 0, 1}, {0, 9, 3}, {0, 1, 1}};
+
+  GroupWithMorphisms I = compute_image(3, f, X, Y);
+  GroupWithMorphisms I_group = compute_image(3, f, X, Y, MapRequest::None);
+  GroupWithMorphisms I_from = compute_image(3, f, X, Y, MapRequest::MapsFrom);
+
+  for (const GroupWithMorphisms* result : {&I_group, &I_from}) {
+    ASSERT_EQ(I.group.tor_rank(), result->group.tor_rank());
+    for (std::size_t i = 0; i < I.group.tor_rank(); ++i) {
+      EXPECT_EQ(I.group(i), result->group(i));
+    }
+    EXPECT_TRUE(result->maps_to.empty());
+  }
+  EXPECT_TRUE(I_group.maps_from.empty());
+  ASSERT_EQ(1, I_from.maps_from.size());
+  EXPECT_EQ(I.maps_from[0], I_from.maps_from[0]);
+}
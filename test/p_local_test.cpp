@@ -30,3 +30,17 @@ TEST(PLocal, PowRational)
   EXPECT_EQ(25, p_pow_q(5, 2));
   EXPECT_EQ(1/9_mpq, p_pow_q(3, -2));
 }
+
+TEST(PLocal, ResidueRational)
+{
+  std::uint32_t residue = 0;
+
+  EXPECT_TRUE(residue_mod_p(7, -3_mpq / 2, residue));
+  EXPECT_EQ(2, residue);
+  EXPECT_TRUE(residue_mod_p(5, 10_mpq / 3, residue));
+  EXPECT_EQ(0, residue);
+  EXPECT_FALSE(residue_mod_p(3, 1_mpq / 6, residue));
+  EXPECT_TRUE(residue_mod_p(2, -7_mpq / 3, residue));
+  EXPECT_EQ(1, residue);
+  EXPECT_FALSE(residue_mod_p(2, 1_mpq / 4, residue));
+}
@@ -4,6 +4,8 @@
 
 #include "../src/matrix.h"
 #include "../src/smith.h"
+#include "../src/zpn.h"
+#include "generators.h"
 
 TEST(SmithReduceP, Empty)
 {
@@ -46,3 +48,311 @@ TEST(SmithReduceP, AntiDiagonal)
 
   EXPECT_EQ(MatrixQ({{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}), f);
 }
+
+TEST(SmithReduceP, Zpn)
+{
+  Zpn::Precision precision(3, 5);
+
+  Matrix<Zpn> f(2, 3);
+  f(0, 0) = 6;
+  f(0, 1) = 9;
+  f(1, 1) = 3;
+  f(1, 2) = 27;
+
+  auto to_X = MatrixRefList<Zpn>();
+  auto from_X = MatrixRefList<Zpn>();
+  auto to_Y = MatrixRefList<Zpn>();
+  auto from_Y = MatrixRefList<Zpn>();
+
+  smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y);
+
+  Matrix<Zpn> g(2, 3);
+  g(0, 0) = 3;
+  g(1, 1) = 3;
+  EXPECT_EQ(g, f);
+}
+
+TEST(SmithReduceP, Transforms)
+{
+  const MatrixQ f_orig = {
+      {4, 6, 0, 2}, {3, 9, 12, 0}, {0, 2, 8, 6}, {5, 0, 0, 10}};
+  MatrixQ f = f_orig;
+  MatrixQ T = MatrixQ::identity(4);
+  MatrixQ S = MatrixQ::identity(4);
+
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList({S});
+  auto to_Y = MatrixQRefList({T});
+  auto from_Y = MatrixQRefList();
+
+  SmithStats stats;
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y, &stats);
+
+  EXPECT_EQ(4, stats.pivots);
+  EXPECT_LE(0, stats.pivot_seconds);
+  EXPECT_EQ(T * f_orig * S, f);
+  for (std::size_t i = 0; i < 4; ++i) {
+    for (std::size_t j = 0; j < 4; ++j) {
+      if (i != j) {
+        EXPECT_EQ(0, f(i, j));
+      }
+    }
+  }
+  EXPECT_EQ(1, f(0, 0));
+}
+
+TEST(SmithReduceP, ColMajorTransforms)
+{
+  const MatrixQ f_orig = {
+      {4, 6, 0, 2}, {3, 9, 12, 0}, {0, 2, 8, 6}, {5, 0, 0, 10}};
+  MatrixQ f = f_orig;
+  MatrixQ T = MatrixQ::identity(4);
+  Matrix<mpq_class, ColMajor> S = MatrixQ::identity(4);
+
+  MatrixQRefList to_X;
+  MatrixRefList<mpq_class, ColMajor> from_X = {S};
+  MatrixQRefList to_Y = {T};
+  MatrixRefList<mpq_class, ColMajor> from_Y;
+
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y);
+
+  EXPECT_EQ(T * f_orig * MatrixQ(std::move(S)), f);
+}
+
+TEST(SmithReduceP, Sparse)
+{
+  const MatrixQ f_orig = {
+      {4, 6, 0, 2}, {3, 9, 12, 0}, {0, 2, 8, 6}, {5, 0, 0, 10}};
+  SparseMatrixQ f(f_orig);
+  MatrixQ g = f_orig;
+  MatrixQ T = MatrixQ::identity(4);
+  MatrixQ S = MatrixQ::identity(4);
+
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList({S});
+  auto to_Y = MatrixQRefList({T});
+  auto from_Y = MatrixQRefList();
+
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y);
+
+  EXPECT_EQ(T * f_orig * S, f);
+  EXPECT_EQ(4, f.nonzeros());
+
+  auto none = MatrixQRefList();
+  auto none_2 = MatrixQRefList();
+  auto none_3 = MatrixQRefList();
+  auto none_4 = MatrixQRefList();
+  smith_reduce_p(2, g, none, none_2, none_3, none_4);
+  EXPECT_EQ(g, f);
+}
+
+TEST(SmithReduceP, SparseRandom)
+{
+  for (const std::size_t p : {std::size_t(2), std::size_t(3)}) {
+    const MatrixQ f_orig = sparse_test_matrix(5 + p, 60, 80, 8, 12);
+    SparseMatrixQ f(f_orig);
+    MatrixQ g = f_orig;
+    MatrixQ T = MatrixQ::identity(60);
+    MatrixQ S = MatrixQ::identity(80);
+
+    auto to_X = MatrixQRefList();
+    auto from_X = MatrixQRefList({S});
+    auto to_Y = MatrixQRefList({T});
+    auto from_Y = MatrixQRefList();
+    smith_reduce_p(p, f, to_X, from_X, to_Y, from_Y);
+
+    auto none = MatrixQRefList();
+    auto none_2 = MatrixQRefList();
+    auto none_3 = MatrixQRefList();
+    auto none_4 = MatrixQRefList();
+    smith_reduce_p(p, g, none, none_2, none_3, none_4);
+
+    EXPECT_EQ(g, f);
+    EXPECT_EQ(T * f_orig * S, f);
+  }
+}
+
+TEST(SmithReduceP, TransformLog)
+{
+  const MatrixQ f_orig = {{6, 4, 2}, {3, 0, 9}};
+  MatrixQ f = f_orig;
+
+  TransformLog<mpq_class> log_X;
+  TransformLog<mpq_class> log_Y;
+  smith_reduce_p(3, f, log_X, log_Y);
+
+  MatrixQ T = MatrixQ::identity(2);
+  MatrixQ S = MatrixQ::identity(3);
+  log_Y.apply_to(T);
+  log_X.apply_from(S);
+
+  EXPECT_EQ(MatrixQ({{1, 0, 0}, {0, 3, 0}}), f);
+  EXPECT_EQ(T * f_orig * S, f);
+}
+
+TEST(SmithReduceP, Threads)
+{
+  // Wide enough for the row eliminations to be split over several workers.
+  const MatrixQ f_orig = sparse_test_matrix(1, 40, 300, 5, 9);
+
+  MatrixQ f_serial = f_orig;
+  MatrixQ T_serial = MatrixQ::identity(40);
+  MatrixQ S_serial = MatrixQ::identity(300);
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList{S_serial};
+  auto to_Y = MatrixQRefList{T_serial};
+  auto from_Y = MatrixQRefList();
+  smith_reduce_p(3, f_serial, to_X, from_X, to_Y, from_Y);
+
+  set_smith_threads(4);
+  EXPECT_EQ(4, smith_threads());
+  EXPECT_EQ(4, matrix_threads());
+
+  MatrixQ f_threaded = f_orig;
+  MatrixQ T_threaded = MatrixQ::identity(40);
+  MatrixQ S_threaded = MatrixQ::identity(300);
+  auto from_X_threaded = MatrixQRefList{S_threaded};
+  auto to_Y_threaded = MatrixQRefList{T_threaded};
+  smith_reduce_p(3, f_threaded, to_X, from_X_threaded, to_Y_threaded, from_Y);
+
+  Zpn::Precision precision(3, 7);
+  Matrix<Zpn> g(40, 300);
+  for (std::size_t i = 0; i < g.height(); ++i) {
+    for (std::size_t j = 0; j < g.width(); ++j) {
+      g(i, j) = Zpn(f_orig(i, j));
+    }
+  }
+  auto to_X_zpn = MatrixRefList<Zpn>();
+  auto from_X_zpn = MatrixRefList<Zpn>();
+  auto to_Y_zpn = MatrixRefList<Zpn>();
+  auto from_Y_zpn = MatrixRefList<Zpn>();
+  smith_reduce_p(3, g, to_X_zpn, from_X_zpn, to_Y_zpn, from_Y_zpn);
+
+  set_smith_threads(1);
+  EXPECT_EQ(1, smith_threads());
+  EXPECT_EQ(1, matrix_threads());
+
+  EXPECT_EQ(f_serial, f_threaded);
+  EXPECT_EQ(T_serial, T_threaded);
+  EXPECT_EQ(S_serial, S_threaded);
+  EXPECT_EQ(f_serial, T_threaded * f_orig * S_threaded);
+  for (std::size_t d = 0; d < 40; ++d) {
+    EXPECT_EQ(p_val_q(3, f_serial(d, d)),
+              g(d, d) ? p_val_q(3, g(d, d)) : long(7));
+  }
+}
+
+TEST(SmithReduceP, UnitPivots)
+{
+  const MatrixQ f_orig = {{1_mpq / 2, 3, 0, 9},
+                          {3, 6, 9, 12},
+                          {5, 1, 4, 0},
+                          {2_mpq / 5, 0, 6, 4}};
+
+  MatrixQ f = f_orig;
+  MatrixQ T = MatrixQ::identity(4);
+  MatrixQ S = MatrixQ::identity(4);
+  MatrixQRefList to_X;
+  MatrixQRefList from_X = {S};
+  MatrixQRefList to_Y = {T};
+  MatrixQRefList from_Y;
+  SmithStats stats;
+  smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y, &stats);
+
+  set_smith_unit_pivots(false);
+  MatrixQ g = f_orig;
+  SmithStats stats_without;
+  MatrixQRefList none;
+  smith_reduce_p(3, g, to_X, none, none, from_Y, &stats_without);
+  set_smith_unit_pivots(true);
+
+  EXPECT_EQ(3, stats.unit_pivots);
+  EXPECT_EQ(0, stats_without.unit_pivots);
+  EXPECT_EQ(g, f);
+  EXPECT_EQ(T * f_orig * S, f);
+
+  MatrixQ h = {{1_mpq / 3, 1}, {1, 1}};
+  SmithStats stats_non_integral;
+  EXPECT_THROW(smith_reduce_p(3, h, to_X, none, none, from_Y,
+                              &stats_non_integral),
+               std::logic_error);
+  EXPECT_EQ(0, stats_non_integral.unit_pivots);
+}
+
+TEST(SmithReduceP, UnitPivotsPacked)
+{
+  // More than 64 columns, so that the rows mod 2 take several words.
+  const MatrixQ f_orig = sparse_test_matrix(7, 20, 150, 3, 6);
+
+  MatrixQ f = f_orig;
+  MatrixQ T = MatrixQ::identity(20);
+  MatrixQRefList to_X;
+  MatrixQRefList from_X;
+  MatrixQRefList to_Y = {T};
+  MatrixQRefList from_Y;
+  SmithStats stats;
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y, &stats);
+
+  set_smith_unit_pivots(false);
+  MatrixQ g = f_orig;
+  MatrixQRefList none;
+  smith_reduce_p(2, g, to_X, from_X, none, from_Y);
+  set_smith_unit_pivots(true);
+
+  EXPECT_LT(0, stats.unit_pivots);
+  EXPECT_EQ(g, f);
+  for (std::size_t d = 0; d < stats.unit_pivots; ++d) EXPECT_EQ(1, f(d, d));
+}
+
+TEST(SmithReduceP, FractionFree)
+{
+  const MatrixQ f_orig = {{2_mpq / 5, 6, 0, 18, 4},
+                          {3, 9, 12_mpq / 7, 0, 1},
+                          {0, 2, 8, 6, 10},
+                          {5, 0, 0, 10, 15},
+                          {9, 27, 3_mpq / 2, 0, 12}};
+
+  EXPECT_TRUE(smith_fraction_free());
+
+  MatrixQ f = f_orig;
+  MatrixQ T = MatrixQ::identity(5);
+  MatrixQ S = MatrixQ::identity(5);
+  MatrixQRefList to_X;
+  MatrixQRefList from_X = {S};
+  MatrixQRefList to_Y = {T};
+  MatrixQRefList from_Y;
+  smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y);
+
+  // Without unit pivots, every pivot goes through the pivot index.
+  set_smith_unit_pivots(false);
+  MatrixQ g = f_orig;
+  MatrixQ U = MatrixQ::identity(5);
+  MatrixQ V = MatrixQ::identity(5);
+  MatrixQRefList from_X_g = {V};
+  MatrixQRefList to_Y_g = {U};
+  smith_reduce_p(3, g, to_X, from_X_g, to_Y_g, from_Y);
+  set_smith_unit_pivots(true);
+
+  MatrixQ h = {{1_mpq / 3}};
+  EXPECT_THROW(smith_reduce_p(3, h, to_X, from_Y, from_Y, from_Y),
+               std::logic_error);
+
+  set_smith_fraction_free(false);
+  MatrixQ f_ref = f_orig;
+  MatrixQRefList none;
+  smith_reduce_p(3, f_ref, to_X, none, none, from_Y);
+  set_smith_fraction_free(true);
+
+  EXPECT_EQ(f_ref, f);
+  EXPECT_EQ(f_ref, g);
+  EXPECT_EQ(T * f_orig * S, f);
+  EXPECT_EQ(U * f_orig * V, g);
+
+  // Integer matrices stored compactly.
+  Matrix<mpz_class> id = Matrix<mpz_class>::identity(3);
+  id.row_mul(1, 3).col_swap(0, 2);
+  TransformLog<mpq_class> log_X;
+  TransformLog<mpq_class> log_Y;
+  smith_reduce_p(3, id, log_X, log_Y);
+  EXPECT_EQ(Matrix<mpz_class>({{1, 0, 0}, {0, 1, 0}, {0, 0, 3}}), id);
+}
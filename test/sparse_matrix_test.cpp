@@ -0,0 +1,79 @@
+#include <exception>
+
+#include <gmpxx.h>
+#include "gtest/gtest.h"
+
+#include "../src/matrix.h"
+#include "../src/sparse_matrix.h"
+
+TEST(SparseMatrix, Properties)
+{
+  SparseMatrixQ A(3, 2);
+
+  EXPECT_EQ(3, A.height());
+  EXPECT_EQ(2, A.width());
+  EXPECT_EQ(0, A.nonzeros());
+  EXPECT_EQ(MatrixQ(3, 2), A);
+}
+
+TEST(SparseMatrix, Set)
+{
+  SparseMatrixQ A(2, 3);
+  A.set(1, 2, 5);
+  A.set(1, 0, 4);
+  A.set(0, 1, 2);
+  A.set(0, 1, 0);
+
+  EXPECT_EQ(MatrixQ({{0, 0, 0}, {4, 0, 5}}), A);
+  EXPECT_EQ(2, A.nonzeros());
+  EXPECT_EQ(2, A.row(1).size());
+  EXPECT_EQ(0, A.col(1).size());
+}
+
+TEST(SparseMatrix, RowOperations)
+{
+  MatrixQ A = {{1, 0, 3}, {0, 5, -6}, {7, 0, 0}};
+  SparseMatrixQ B(A);
+
+  A.row_add(0, 1, 2_mpq);
+  B.row_add(0, 1, 2_mpq);
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(2, B.row(1).size());
+
+  A.row_mul(2, 1 / 2_mpq);
+  B.row_mul(2, 1 / 2_mpq);
+  EXPECT_EQ(A, B);
+
+  A.row_swap(0, 2);
+  B.row_swap(0, 2);
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(SparseMatrixQ(A).col(0).size(), B.col(0).size());
+}
+
+TEST(SparseMatrix, ColOperations)
+{
+  MatrixQ A = {{1, 0, 3}, {0, 5, -6}, {7, 0, 0}};
+  SparseMatrixQ B(A);
+
+  A.col_add(0, 2, -3_mpq);
+  B.col_add(0, 2, -3_mpq);
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(1, B.row(0).size());
+
+  A.col_mul(1, 0_mpq);
+  B.col_mul(1, 0_mpq);
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(0, B.col(1).size());
+
+  A.col_swap(0, 2);
+  B.col_swap(0, 2);
+  EXPECT_EQ(A, B);
+}
+
+TEST(SparseMatrix, Composition)
+{
+  SparseMatrixQ A(MatrixQ({{1, 0, 1}, {0, 1, 1}}));
+  MatrixQ B = {{1, 0}, {0, 1}, {1, 1}};
+
+  EXPECT_EQ(MatrixQ({{2, 1}, {1, 2}}), A * B);
+}
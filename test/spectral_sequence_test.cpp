@@ -1,5 +1,9 @@
+#include <tuple>
+#include <vector>
+
 #include "gtest/gtest.h"
 
+#include "../src/smith.h"
 #include "../src/spectral_sequence.h"
 
 TEST(TrigradedIndex, Equality)
@@ -23,3 +27,116 @@ TEST(TrigradedIndex, LessThan)
   EXPECT_LT(ind_3, ind_4);
   EXPECT_LT(ind_4, ind_5);
 }
+
+TEST(GroupSequence, Lookup)
+{
+  AbelianGroup X(0, 1);
+  X(0) = 2;
+  AbelianGroup Y(0, 1);
+  Y(0) = 1;
+
+  GroupSequence seq(2, X);
+  EXPECT_EQ(2, seq.get_group(2)(0));
+  EXPECT_THROW(seq.get_group(3), std::logic_error);
+
+  seq.inc();
+  EXPECT_EQ(2, seq.get_group(3)(0));
+  seq.append(4, Y, MatrixQ({{3}}));
+  EXPECT_EQ(2, seq.get_group(3)(0));
+  EXPECT_EQ(1, seq.get_group(4)(0));
+  EXPECT_EQ(MatrixQ({{3}}), seq.get_matrix(4));
+
+  seq.done();
+  EXPECT_EQ(1, seq.get_group(10)(0));
+}
+
+TEST(SpectralSequence, SetDiffs)
+{
+  AbelianGroup Z9(0, 1);
+  Z9(0) = 2;
+
+  // On page 2 the differentials go from (p, q, s) to (p + 2, q - 1, s - 1).
+  std::vector<TrigradedIndex> indices = {
+      TrigradedIndex(0, 1, 1), TrigradedIndex(2, 0, 0),
+      TrigradedIndex(1, 1, 1), TrigradedIndex(3, 0, 0),
+      TrigradedIndex(4, -1, -1)};
+
+  DifferentialList diffs;
+  diffs.emplace_back(TrigradedIndex(2, 0, 0), MatrixQ({{3}}));
+  diffs.emplace_back(TrigradedIndex(3, 0, 0), MatrixQ({{9}}));
+  diffs.emplace_back(TrigradedIndex(4, -1, -1), MatrixQ({{1}}));
+
+  SpectralSequence serial(3);
+  SpectralSequence threaded(3);
+  for (const TrigradedIndex& pqs : indices) {
+    serial.set_group(pqs, 2, Z9);
+    threaded.set_group(pqs, 2, Z9);
+  }
+
+  for (const auto& diff : diffs) serial.set_diff(diff.first, 2, diff.second);
+
+  set_smith_threads(3);
+  threaded.set_diffs(2, diffs);
+  EXPECT_THROW(threaded.set_diffs(2, diffs), std::logic_error);
+  set_smith_threads(1);
+
+  // Z/9 -> Z/9, x -> 3x has kernel and cokernel Z/3, x -> 9x is zero and
+  // (2, 0, 0) -> (4, -1, -1) is an isomorphism.
+  const std::vector<std::tuple<TrigradedIndex, std::size_t, std::size_t>>
+      expected = {std::make_tuple(TrigradedIndex(0, 1, 1), 1, 2),
+                  std::make_tuple(TrigradedIndex(2, 0, 0), 0, 1),
+                  std::make_tuple(TrigradedIndex(1, 1, 1), 2, 2),
+                  std::make_tuple(TrigradedIndex(3, 0, 0), 2, 2),
+                  std::make_tuple(TrigradedIndex(4, -1, -1), 2, 0)};
+
+  for (SpectralSequence* spec : {&serial, &threaded}) {
+    for (const auto& entry : expected) {
+      const TrigradedIndex& pqs = std::get<0>(entry);
+      const std::size_t kernel_order = std::get<1>(entry);
+      const std::size_t cokernel_order = std::get<2>(entry);
+
+      GroupSequence& kers = spec->get_kernels(pqs);
+      GroupSequence& cokers = spec->get_cokernels(pqs);
+
+      const AbelianGroup& K = kers.get_group(kers.get_current());
+      const AbelianGroup& C = cokers.get_group(cokers.get_current());
+      EXPECT_EQ(kernel_order ? 1 : 0, K.tor_rank());
+      if (kernel_order) {
+        EXPECT_EQ(kernel_order, K(0));
+      }
+      EXPECT_EQ(cokernel_order ? 1 : 0, C.tor_rank());
+      if (cokernel_order) {
+        EXPECT_EQ(cokernel_order, C(0));
+      }
+    }
+  }
+}
+
+TEST(SpectralSequence, EAB)
+{
+  AbelianGroup Z9(0, 1);
+  Z9(0) = 2;
+
+  SpectralSequence spec(3);
+  spec.set_group(TrigradedIndex(0, 1, 1), 2, Z9);
+  spec.set_group(TrigradedIndex(2, 0, 0), 2, Z9);
+
+  const AbelianGroup& E2 = spec.get_e_ab(TrigradedIndex(0, 1, 1), 2, 2);
+  ASSERT_EQ(1, E2.tor_rank());
+  EXPECT_EQ(2, E2(0));
+  EXPECT_EQ(&E2, &spec.get_e_ab(TrigradedIndex(0, 1, 1), 2, 2));
+  EXPECT_THROW(spec.get_e_ab(TrigradedIndex(0, 1, 1), 3, 3), std::logic_error);
+
+  spec.set_diff(TrigradedIndex(2, 0, 0), 2, MatrixQ({{3}}));
+
+  // Only the kernel at the source and the cokernel at the target moved on.
+  EXPECT_THROW(spec.get_e_ab(TrigradedIndex(0, 1, 1), 3, 3), std::logic_error);
+
+  const AbelianGroup& E32 = spec.get_e_ab(TrigradedIndex(0, 1, 1), 3, 2);
+  ASSERT_EQ(1, E32.tor_rank());
+  EXPECT_EQ(1, E32(0));
+
+  const AbelianGroup& E23 = spec.get_e_ab(TrigradedIndex(2, 0, 0), 2, 3);
+  ASSERT_EQ(1, E23.tor_rank());
+  EXPECT_EQ(1, E23(0));
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/thread_pool.h"
+
+TEST(ThreadPool, Coverage)
+{
+  ThreadPool pool(3);
+  EXPECT_EQ(3, pool.size());
+
+  std::vector<int> hits(1000, 0);
+  pool.parallel_for(0, hits.size(), 7, [&](std::size_t begin, std::size_t end) {
+    EXPECT_LE(begin, end);
+    for (std::size_t k = begin; k < end; ++k) ++hits[k];
+  });
+
+  for (int hit : hits) EXPECT_EQ(1, hit);
+
+  pool.parallel_for(5, 5, 1, [](std::size_t, std::size_t) { FAIL(); });
+}
+
+TEST(ThreadPool, Serial)
+{
+  std::size_t calls = 0;
+  parallel_for(nullptr, 2, 10, 1, [&](std::size_t begin, std::size_t end) {
+    EXPECT_EQ(2, begin);
+    EXPECT_EQ(10, end);
+    ++calls;
+  });
+
+  EXPECT_EQ(1, calls);
+}
+
+TEST(ThreadPool, Exception)
+{
+  ThreadPool pool(2);
+
+  EXPECT_THROW(
+      pool.parallel_for(0, 100, 1,
+                        [](std::size_t begin, std::size_t end) {
+                          if (begin <= 50 && 50 < end)
+                            throw std::logic_error("ThreadPool test");
+                        }),
+      std::logic_error);
+
+  std::atomic<std::size_t> sum(0);
+  pool.parallel_for(0, 100, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; ++k) sum += k;
+  });
+  EXPECT_EQ(4950, sum);
+}
+
+TEST(ThreadPool, Nested)
+{
+  ThreadPool pool(2);
+
+  std::atomic<std::size_t> count(0);
+  pool.parallel_for(0, 8, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; ++k) {
+      pool.parallel_for(0, 8, 1, [&](std::size_t b, std::size_t e) {
+        count += e - b;
+      });
+    }
+  });
+
+  EXPECT_EQ(64, count);
+}
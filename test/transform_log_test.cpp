@@ -0,0 +1,107 @@
+#include <gmpxx.h>
+#include "gtest/gtest.h"
+
+#include "../src/matrix.h"
+#include "../src/transform_log.h"
+
+TEST(TransformLog, MatchesEagerOperations)
+{
+  MatrixQ A = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  MatrixQ B = {{1, 0, 2}, {0, 3, 0}};
+  MatrixQ A_eager = A;
+  MatrixQ B_eager = B;
+
+  MatrixQRefList to_X = {A_eager};
+  MatrixQRefList from_X = {B_eager};
+  TransformLog<mpq_class> log;
+
+  basis_vectors_add(to_X, from_X, 0, 2, 2_mpq);
+  log.add(0, 2, 2_mpq);
+  basis_vectors_swap(to_X, from_X, 1, 2);
+  log.swap(1, 2);
+  basis_vectors_mul(to_X, from_X, 1, 3_mpq);
+  log.mul(1, 3_mpq);
+
+  EXPECT_EQ(3, log.size());
+
+  MatrixQRefList to_X_log = {A};
+  MatrixQRefList from_X_log = {B};
+  log.apply(to_X_log, from_X_log);
+
+  EXPECT_EQ(A_eager, A);
+  EXPECT_EQ(B_eager, B);
+}
+
+TEST(TransformLog, PartialApply)
+{
+  TransformLog<mpq_class> log;
+  log.add(0, 1, -1_mpq);
+  log.mul(0, 2_mpq);
+  log.swap(0, 1);
+
+  MatrixQ A = MatrixQ::identity(2);
+  MatrixQ A_part = MatrixQ::identity(2);
+  log.apply_to(A);
+  log.apply_to(A_part, 1, 2);
+
+  EXPECT_EQ(A(0, 1), A_part(0, 1));
+  EXPECT_EQ(A(1, 1), A_part(1, 1));
+  EXPECT_EQ(1, A_part(0, 0));
+
+  MatrixQ B = MatrixQ::identity(2);
+  MatrixQ B_part = MatrixQ::identity(2);
+  log.apply_from(B);
+  log.apply_from(B_part, 0, 1);
+
+  EXPECT_EQ(B(0, 0), B_part(0, 0));
+  EXPECT_EQ(B(0, 1), B_part(0, 1));
+  EXPECT_EQ(1, B_part(1, 1));
+  EXPECT_EQ(MatrixQ::identity(2), A * B);
+}
+
+TEST(TransformLog, NotRecording)
+{
+  TransformLog<mpq_class> log(false);
+
+  log.add(0, 2, 2_mpq);
+  log.swap(1, 2);
+  log.mul(1, 3_mpq);
+
+  EXPECT_FALSE(log.recording());
+  EXPECT_EQ(0, log.size());
+}
+
+TEST(TransformLog, Compact)
+{
+  TransformLog<mpq_class> log;
+  log.swap(0, 2);
+  log.mul(1, 3_mpq);
+  log.add(2, 1, 2_mpq);
+  log.mul(0, 5_mpq);
+
+  MatrixQ A = MatrixQ::identity(3);
+  MatrixQ A_dense = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  Matrix<mpq_class, ColMajor> B = MatrixQ::identity(3);
+  Matrix<mpq_class, ColMajor> B_dense = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+  MatrixQRefList to_X = {A};
+  MatrixRefList<mpq_class, ColMajor> from_X = {B};
+  log.apply(to_X, from_X);
+  log.apply_to(A_dense);
+  log.apply_from(B_dense);
+
+  EXPECT_FALSE(A.compact());
+  EXPECT_EQ(A_dense, A);
+  EXPECT_EQ(B_dense, B);
+
+  // Without additions the matrices stay compact.
+  TransformLog<mpq_class> monomial_log;
+  monomial_log.swap(0, 1);
+  monomial_log.mul(1, 3_mpq);
+  MatrixQ C = MatrixQ::identity(2);
+  MatrixQRefList to_C = {C};
+  MatrixQRefList from_none;
+  monomial_log.apply(to_C, from_none);
+  EXPECT_TRUE(C.compact());
+  EXPECT_EQ(MatrixQ({{0, 1}, {1_mpq / 3, 0}}), C);
+}
@@ -0,0 +1,57 @@
+#include <exception>
+
+#include "gtest/gtest.h"
+
+#include "../src/unit_pivots.h"
+
+typedef std::vector<std::pair<std::size_t, std::size_t>> Pivots;
+
+TEST(UnitPivots, Empty)
+{
+  std::vector<std::uint32_t> residues;
+
+  EXPECT_EQ(Pivots(), find_unit_pivots(5, 0, 3, residues));
+}
+
+TEST(UnitPivots, Swaps)
+{
+  // The first pivot is moved to the diagonal by swapping columns 0 and 2.
+  std::vector<std::uint32_t> residues = {0, 0, 2,  //
+                                         0, 1, 1,  //
+                                         1, 2, 2};
+
+  EXPECT_EQ(Pivots({{0, 2}, {1, 1}, {2, 2}}),
+            find_unit_pivots(3, 3, 3, residues));
+}
+
+TEST(UnitPivots, Rank)
+{
+  // The third row is the sum of the first two mod 5.
+  std::vector<std::uint32_t> residues = {1, 2, 3, 4,  //
+                                         2, 0, 4, 1,  //
+                                         3, 2, 2, 0};
+
+  EXPECT_EQ(2, find_unit_pivots(5, 3, 4, residues).size());
+}
+
+TEST(UnitPivots, LargePrime)
+{
+  std::vector<std::uint32_t> residues = {1};
+
+  EXPECT_THROW(find_unit_pivots(std::uint64_t(1) << 32, 1, 1, residues),
+               std::logic_error);
+}
+
+TEST(UnitPivots, Packed)
+{
+  // Rows of more than one word; the pivot of the first step is in the last
+  // column and swapped with column 0.
+  std::vector<std::uint32_t> residues(3 * 70);
+  residues[0 * 70 + 69] = 1;
+  residues[1 * 70 + 3] = 1;
+  residues[1 * 70 + 69] = 1;
+  residues[2 * 70 + 0] = 1;
+
+  EXPECT_EQ(Pivots({{0, 69}, {1, 3}, {2, 69}}),
+            find_unit_pivots(2, 3, 70, residues));
+}
@@ -0,0 +1,111 @@
+#include <exception>
+
+#include <gmpxx.h>
+#include "gtest/gtest.h"
+
+#include "../src/matrix.h"
+#include "../src/zpn.h"
+
+TEST(Zpn, Fits)
+{
+  EXPECT_TRUE(Zpn::fits(3, 20));
+  EXPECT_TRUE(Zpn::fits(2, 62));
+  EXPECT_FALSE(Zpn::fits(2, 63));
+  EXPECT_FALSE(Zpn::fits(1, 1));
+}
+
+TEST(Zpn, Zero)
+{
+  Zpn x;
+
+  EXPECT_FALSE(x);
+  EXPECT_THROW(x.valuation(), std::logic_error);
+}
+
+TEST(Zpn, Conversion)
+{
+  Zpn::Precision precision(3, 4);
+
+  EXPECT_EQ(2, Zpn(18).valuation());
+  EXPECT_EQ(Zpn(80), Zpn(-1));
+  EXPECT_EQ(Zpn(0), Zpn(81));
+  EXPECT_EQ(41, Zpn(1_mpq / 2).get_mpz());
+  EXPECT_EQ(Zpn(5), Zpn(mpz_class(-76)));
+  EXPECT_THROW(Zpn(1_mpq / 3), std::logic_error);
+
+  std::uint32_t residue = 0;
+  EXPECT_TRUE(residue_mod_p(3, Zpn(-1), residue));
+  EXPECT_EQ(2, residue);
+  EXPECT_TRUE(residue_mod_p(3, Zpn(6), residue));
+  EXPECT_EQ(0, residue);
+}
+
+TEST(Zpn, Arithmetic)
+{
+  Zpn::Precision precision(3, 4);
+
+  EXPECT_EQ(Zpn(7), Zpn(3) + Zpn(4));
+  EXPECT_EQ(Zpn(79), Zpn(3) - Zpn(5));
+  EXPECT_EQ(Zpn(0), Zpn(9) * Zpn(18));
+  EXPECT_EQ(Zpn(54), Zpn(9) * Zpn(6));
+  EXPECT_EQ(Zpn(1), Zpn(2) * (1 / Zpn(2)));
+  EXPECT_EQ(Zpn(3) * Zpn(1_mpq / 2), Zpn(9) / Zpn(6));
+  EXPECT_THROW(Zpn(6) / Zpn(9), std::logic_error);
+  EXPECT_THROW(Zpn(6) / Zpn(), std::logic_error);
+}
+
+TEST(Zpn, PowerOfTwo)
+{
+  Zpn::Precision precision(2, 62);
+  const mpz_class modulus = mpz_class(1) << 62;
+
+  const mpz_class a("3456789012345678901");
+  const mpz_class b("-1234567890123456789");
+  mpz_class product = a * b % modulus;
+  if (product < 0) product += modulus;
+  EXPECT_EQ(product, (Zpn(a) * Zpn(b)).get_mpz());
+
+  for (const mpz_class& x : {a, b, mpz_class(1), mpz_class(-1)}) {
+    EXPECT_EQ(Zpn(1), Zpn(x) * (1 / Zpn(x)));
+  }
+  EXPECT_EQ(Zpn(3), Zpn(12) / Zpn(4));
+  EXPECT_EQ(Zpn(a), Zpn(mpq_class(a * 5, 5)));
+  EXPECT_THROW(Zpn(1_mpq / 2), std::logic_error);
+}
+
+TEST(Zpn, NestedPrecision)
+{
+  Zpn::Precision outer(2, 3);
+  {
+    Zpn::Precision inner(5, 2);
+    EXPECT_EQ(Zpn(0), Zpn(25));
+  }
+  EXPECT_EQ(Zpn(0), Zpn(8));
+  EXPECT_NE(Zpn(0), Zpn(25));
+  EXPECT_EQ(2, Zpn(12).valuation());
+}
+
+TEST(Zpn, MatrixKernels)
+{
+  // Row operations are contiguous in the first matrix and strided in the
+  // second one, so both code paths have to agree.
+  Zpn::Precision precision(7, 5);
+
+  Matrix<Zpn> f(3, 11);
+  Matrix<Zpn, ColMajor> g(3, 11);
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 11; ++j) {
+      f(i, j) = g(i, j) = Zpn(long(i * 1000 + j * j * 37) - 2000);
+    }
+  }
+
+  f.row_add(0, 2, Zpn(-3)).row_mul(1, Zpn(16806)).row_add(1, 0, Zpn(49));
+  g.row_add(0, 2, Zpn(-3)).row_mul(1, Zpn(16806)).row_add(1, 0, Zpn(49));
+
+  EXPECT_EQ(f, g);
+  // 16806 = -1 modulo 7^5.
+  EXPECT_EQ(Zpn(-1963 + 49 * 963), f(0, 1));
+
+  EXPECT_EQ(f, f * Matrix<Zpn>(Matrix<Zpn>::identity(11)));
+  EXPECT_EQ(f, (f * Matrix<Zpn, ColMajor>(Matrix<Zpn>::identity(11))));
+}